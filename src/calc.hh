@@ -44,12 +44,56 @@
 #include <string>
 #include <map>
 
+#include <cstring>
+
 /*!
  * This namespace is used to shield the class definitions
  */
 namespace calc_defs {
   
   using namespace ::std;
+
+  template <typename T_type> class Program;
+  template <typename T_type> class Deck;
+
+  /*!
+   * Base class for unary functions with an internal state (tables,
+   * caches, ...), registered with `Calculator::set_unary_fun`.
+   * The evaluator does not take the ownership of the object.
+   */
+  template <typename T_type = double>
+  class Unary_function {
+  public:
+    virtual ~Unary_function() {}
+
+    //! \return the value of the function in `x`
+    virtual T_type eval( T_type x ) = 0;
+
+    //! evaluate the function on `n` values, used by Program
+    virtual
+    void
+    eval( int n, T_type const * x, T_type * y )
+    { for ( int i = 0; i < n; ++i ) y[i] = eval(x[i]); }
+  };
+
+  /*!
+   * Base class for binary functions with an internal state,
+   * registered with `Calculator::set_binary_fun`.
+   */
+  template <typename T_type = double>
+  class Binary_function {
+  public:
+    virtual ~Binary_function() {}
+
+    //! \return the value of the function in `(x,y)`
+    virtual T_type eval( T_type x, T_type y ) = 0;
+
+    //! evaluate the function on `n` couples, used by Program
+    virtual
+    void
+    eval( int n, T_type const * x, T_type const * y, T_type * z )
+    { for ( int i = 0; i < n; ++i ) z[i] = eval(x[i],y[i]); }
+  };
    
   /*!
    * This class implement the expression evaluator
@@ -71,14 +115,23 @@ namespace calc_defs {
     typedef value_type (*Func1)(value_type);
     typedef value_type (*Func2)(value_type,value_type);
   
+    typedef Unary_function<value_type>  Object1;
+    typedef Binary_function<value_type> Object2;
+
     typedef map<string,Func1>      map_fun1;
     typedef map<string,Func2>      map_fun2;
+    typedef map<string,Object1*>   map_obj1;
+    typedef map<string,Object2*>   map_obj2;
     typedef map<string,value_type> map_real;
   
     typedef typename map_fun1::iterator       map_fun1_iterator;
     typedef typename map_fun1::const_iterator map_fun1_const_iterator;
     typedef typename map_fun2::iterator       map_fun2_iterator;
     typedef typename map_fun2::const_iterator map_fun2_const_iterator;
+    typedef typename map_obj1::iterator       map_obj1_iterator;
+    typedef typename map_obj1::const_iterator map_obj1_const_iterator;
+    typedef typename map_obj2::iterator       map_obj2_iterator;
+    typedef typename map_obj2::const_iterator map_obj2_const_iterator;
     typedef typename map_real::iterator       map_real_iterator;
     typedef typename map_real::const_iterator map_real_const_iterator;
   
@@ -89,10 +142,49 @@ namespace calc_defs {
     static value_type internal_neg (value_type x) { return x > 0 ? 0 : x; }
     static value_type internal_max (value_type a, value_type b) { return a > b ? a : b; }
     static value_type internal_min (value_type a, value_type b) { return a < b ? a : b; }
-  
+
+    /*
+     * Builtin functions and constants are stored in immutable tables
+     * shared by all the instances and sorted by name for binary search.
+     * The maps below contain only the user defined symbols, which
+     * shadow the builtin ones with the same name.
+     */
+    typedef struct { char const * name; Func1      fun;   } Builtin_fun1;
+    typedef struct { char const * name; Func2      fun;   } Builtin_fun2;
+    typedef struct { char const * name; value_type value; } Builtin_real;
+
+    enum { n_builtin_fun1 = 18, n_builtin_fun2 = 4, n_builtin_real = 2 };
+
+    static Builtin_fun1 const builtin_fun1[n_builtin_fun1];
+    static Builtin_fun2 const builtin_fun2[n_builtin_fun2];
+    static Builtin_real const builtin_real[n_builtin_real];
+
+    template <typename ENTRY>
+    static
+    int
+    builtin_find( ENTRY const tab[], int n, char const * name ) {
+      int lo = 0, hi = n;
+      while ( lo < hi ) {
+        int mid = (lo+hi)/2;
+        int cmp = strcmp( name, tab[mid].name );
+        if ( cmp == 0 ) return mid;
+        if ( cmp < 0 ) hi = mid;
+        else           lo = mid+1;
+      }
+      return -1;
+    }
+
     map_fun1 unary_fun;
     map_fun2 binary_fun;
+    map_obj1 unary_obj;
+    map_obj2 binary_obj;
     map_real variables;
+
+    // read only variables shared with other evaluators, may be null
+    map_real const * attached;
+
+    // bit i set when the builtin constant builtin_real[i] was dropped
+    unsigned dropped_real;
   
     typedef enum {
       Number, Variable, Parameter,
@@ -142,13 +234,23 @@ namespace calc_defs {
 
     Calculator(CALCULATOR const &);
     // { init(); }
+
+    // the compiler of batch programs uses the tokenizer and the symbols
+    friend class Program<T_type>;
+
+    // the incremental deck evaluator resolves the names read by a statement
+    friend class Deck<T_type>;
   
   public:
   
     Calculator(void) 
     : unary_fun()
     , binary_fun()
+    , unary_obj()
+    , binary_obj()
     , variables()
+    , attached(0)
+    , dropped_real(0)
     , error_found()
     , token_type()
     , token_string()
@@ -158,7 +260,12 @@ namespace calc_defs {
     { init(); };
 
     ~Calculator(void) { };
-  
+
+    /*!
+     *  Restore the predefined functions and constants, removing the
+     *  user definitions which shadow them.
+     *  Construction and initialization do not allocate memory.
+     */
     void init(void);
     
     /*!
@@ -217,9 +324,14 @@ namespace calc_defs {
      */
     bool
     drop( string const & name ) {
-      map_real_const_iterator ii = variables.find(name);
+      map_real_iterator ii = variables.find(name);
       bool ex = ii != variables.end();
       if ( ex ) variables . erase( ii );
+      int ib = builtin_find( builtin_real, n_builtin_real, name.c_str() );
+      if ( ib >= 0 && (dropped_real & (1u<<ib)) == 0 ) {
+        dropped_real |= 1u<<ib;
+        ex = true;
+      }
       return ex;
 	  }
 
@@ -231,7 +343,7 @@ namespace calc_defs {
      *  \return true if the variable exists
      */
     bool exist(string const & name) const
-    { return variables.find(name) != variables.end(); }
+    { value_type val; return lookup(name,val); }
     bool exist(char const name[]) const { return exist(string(name)); }
   
     /*!
@@ -257,11 +369,24 @@ namespace calc_defs {
      */
     void
     set_unary_fun( char const * f_name, Func1 f_ptr )
-    { unary_fun[f_name] = f_ptr; }
+    { set_unary_fun( string(f_name), f_ptr ); }
 
     void
     set_unary_fun( string const & f_name, Func1 f_ptr )
-    { unary_fun[f_name] = f_ptr; }
+    { unary_obj . erase(f_name); unary_fun[f_name] = f_ptr; }
+
+    /**
+     *  Add unary function object to the parser
+     *  @param f_name function name
+     *  @param f_obj  pointer to the function object, not owned
+     */
+    void
+    set_unary_fun( char const * f_name, Object1 * f_obj )
+    { set_unary_fun( string(f_name), f_obj ); }
+
+    void
+    set_unary_fun( string const & f_name, Object1 * f_obj )
+    { unary_fun . erase(f_name); unary_obj[f_name] = f_obj; }
   
     /*!
      *  Add binary function to the parser
@@ -270,11 +395,24 @@ namespace calc_defs {
      */
     void
     set_binary_fun( char const * f_name, Func2 f_ptr )
-    { binary_fun[f_name] = f_ptr; }
+    { set_binary_fun( string(f_name), f_ptr ); }
 
     void
     set_binary_fun( string const & f_name, Func2 f_ptr )
-    { binary_fun[f_name] = f_ptr; }
+    { binary_obj . erase(f_name); binary_fun[f_name] = f_ptr; }
+
+    /*!
+     *  Add binary function object to the parser
+     *  \param f_name function name
+     *  \param f_obj  pointer to the function object, not owned
+     */
+    void
+    set_binary_fun( char const * f_name, Object2 * f_obj )
+    { set_binary_fun( string(f_name), f_obj ); }
+
+    void
+    set_binary_fun( string const & f_name, Object2 * f_obj )
+    { binary_fun . erase(f_name); binary_obj[f_name] = f_obj; }
 
     /*!
      *  \return true if no error found
@@ -282,9 +420,19 @@ namespace calc_defs {
     bool no_error() const { return No_Error == error_found; }
 
     /*!
-     *  \return a reference of the variables map.
+     *  \return a copy of all the variables visible to the evaluator:
+     *          the predefined constants not dropped, the attached
+     *          variables and the user defined ones, in this order of
+     *          precedence from the lowest.
+     */
+    map_real variables_map() const;
+
+    /*!
+     *  \return a reference of the map of the variables defined by the
+     *          evaluator itself, without the predefined constants `pi`
+     *          and `e` unless redefined and without the attached ones.
      */
-    map_real const & variables_map() const { return variables; }
+    map_real const & variables_overlay() const { return variables; }
     
     /*!
      *  \return a reference of the variables map.
@@ -297,8 +445,61 @@ namespace calc_defs {
       }
     }
 
+    /*!
+     *  Use a read only set of variables, e.g. shared among many
+     *  evaluators.  The variables of the evaluator, including the ones
+     *  assigned while parsing, shadow them.  The map must not be
+     *  modified or destroyed while attached.
+     *  \param vars the variables, 0 to detach
+     */
+    void variables_attach( map_real const * vars ) { attached = vars; }
+
+    //! \return the attached variables, 0 if none
+    map_real const * variables_attached() const { return attached; }
+
+    /*!
+     *  Copy the user defined functions and variables of another
+     *  evaluator, overwriting the ones with the same name.
+     *  Function objects and attached variables are shared, not copied.
+     *  \param ee the evaluator to be copied
+     */
+    void
+    symbols_merge( CALCULATOR const & ee ) {
+      for ( map_fun1_const_iterator f1 = ee.unary_fun . begin();
+            f1 != ee.unary_fun . end(); ++f1 )
+        unary_fun[f1 -> first] = f1 -> second;
+      for ( map_fun2_const_iterator f2 = ee.binary_fun . begin();
+            f2 != ee.binary_fun . end(); ++f2 )
+        binary_fun[f2 -> first] = f2 -> second;
+      for ( map_obj1_const_iterator o1 = ee.unary_obj . begin();
+            o1 != ee.unary_obj . end(); ++o1 )
+        set_unary_fun( o1 -> first, o1 -> second );
+      for ( map_obj2_const_iterator o2 = ee.binary_obj . begin();
+            o2 != ee.binary_obj . end(); ++o2 )
+        set_binary_fun( o2 -> first, o2 -> second );
+      variables_merge( ee.variables );
+      if ( ee.attached != 0 ) attached = ee.attached;
+      dropped_real |= ee.dropped_real;
+    }
+
   private:
-  
+
+    bool  lookup( string const & name, value_type & val ) const;
+    Func1 find_unary_fun( string const & name ) const;
+    Func2 find_binary_fun( string const & name ) const;
+
+    Object1 *
+    find_unary_obj( string const & name ) const {
+      map_obj1_const_iterator o1 = unary_obj . find(name);
+      return o1 != unary_obj . end() ? o1 -> second : 0;
+    }
+
+    Object2 *
+    find_binary_obj( string const & name ) const {
+      map_obj2_const_iterator o2 = binary_obj . find(name);
+      return o2 != binary_obj . end() ? o2 -> second : 0;
+    }
+
     value_type G0(void);
     value_type G1(void);
     value_type G2(void);
@@ -309,45 +510,144 @@ namespace calc_defs {
   
   };
   
+  // must be sorted by name (strcmp order)
+  template <typename T_type>
+  typename Calculator<T_type>::Builtin_fun1 const
+  Calculator<T_type>::builtin_fun1[n_builtin_fun1] = {
+    { "abs",   Calculator<T_type>::internal_abs },
+    { "acos",  acos  },
+    { "asin",  asin  },
+    { "atan",  atan  },
+    { "ceil",  ceil  },
+    { "cos",   cos   },
+    { "cosh",  cosh  },
+    { "exp",   exp   },
+    { "floor", floor },
+    { "log",   log   },
+    { "log10", log10 },
+    { "neg",   Calculator<T_type>::internal_neg },
+    { "pos",   Calculator<T_type>::internal_pos },
+    { "sin",   sin   },
+    { "sinh",  sinh  },
+    { "sqrt",  sqrt  },
+    { "tan",   tan   },
+    { "tanh",  tanh  }
+  };
+
+  template <typename T_type>
+  typename Calculator<T_type>::Builtin_fun2 const
+  Calculator<T_type>::builtin_fun2[n_builtin_fun2] = {
+    { "atan2", atan2 },
+    { "max",   Calculator<T_type>::internal_max },
+    { "min",   Calculator<T_type>::internal_min },
+    { "pow",   pow   }
+  };
+
+  // predefined variables
+  template <typename T_type>
+  typename Calculator<T_type>::Builtin_real const
+  Calculator<T_type>::builtin_real[n_builtin_real] = {
+    { "e",  2.71828182845904523536 },
+    { "pi", 3.14159265358979323846 }
+  };
+
   template <typename T_type>
   inline
   void
   Calculator<T_type>::init() {
-    last_evaluated      = 0;
-
-    unary_fun["abs"]    = internal_abs;
-    unary_fun["pos"]    = internal_pos;
-    unary_fun["neg"]    = internal_neg;
-
-    unary_fun["cos"]    = cos;
-    unary_fun["sin"]    = sin;
-    unary_fun["tan"]    = tan;
-  
-    unary_fun["acos"]   = acos;
-    unary_fun["asin"]   = asin;
-    unary_fun["atan"]   = atan;
-  
-    unary_fun["cosh"]   = cosh;
-    unary_fun["sinh"]   = sinh;
-    unary_fun["tanh"]   = tanh;
-  
-    unary_fun["exp"]    = exp;
-    unary_fun["log"]    = log;
-    unary_fun["log10"]  = log10;
-    unary_fun["sqrt"]   = sqrt;
-    unary_fun["ceil"]   = ceil;
-    unary_fun["floor"]  = floor;
-  
-    binary_fun["atan2"] = atan2;
-    binary_fun["pow"]   = pow;
-    binary_fun["max"]   = internal_max;
-    binary_fun["min"]   = internal_min;
-  
-    // predefined variables
-    variables["pi"]     = 3.14159265358979323846;
-    variables["e"]      = 2.71828182845904523536;
+    last_evaluated = 0;
+    dropped_real   = 0;
+
+    // remove user definitions shadowing the builtins
+    map_fun1_iterator f1 = unary_fun . begin();
+    while ( f1 != unary_fun . end() ) {
+      if ( builtin_find( builtin_fun1, n_builtin_fun1, f1 -> first.c_str() ) >= 0 )
+        unary_fun . erase( f1++ );
+      else
+        ++f1;
+    }
+    map_fun2_iterator f2 = binary_fun . begin();
+    while ( f2 != binary_fun . end() ) {
+      if ( builtin_find( builtin_fun2, n_builtin_fun2, f2 -> first.c_str() ) >= 0 )
+        binary_fun . erase( f2++ );
+      else
+        ++f2;
+    }
+    map_obj1_iterator o1 = unary_obj . begin();
+    while ( o1 != unary_obj . end() ) {
+      if ( builtin_find( builtin_fun1, n_builtin_fun1, o1 -> first.c_str() ) >= 0 )
+        unary_obj . erase( o1++ );
+      else
+        ++o1;
+    }
+    map_obj2_iterator o2 = binary_obj . begin();
+    while ( o2 != binary_obj . end() ) {
+      if ( builtin_find( builtin_fun2, n_builtin_fun2, o2 -> first.c_str() ) >= 0 )
+        binary_obj . erase( o2++ );
+      else
+        ++o2;
+    }
+    map_real_iterator ii = variables . begin();
+    while ( ii != variables . end() ) {
+      if ( builtin_find( builtin_real, n_builtin_real, ii -> first.c_str() ) >= 0 )
+        variables . erase( ii++ );
+      else
+        ++ii;
+    }
   }
-  
+
+  template <typename T_type>
+  typename Calculator<T_type>::map_real
+  Calculator<T_type>::variables_map() const {
+    map_real all;
+    for ( int i = 0; i < n_builtin_real; ++i )
+      if ( (dropped_real & (1u<<i)) == 0 )
+        all[builtin_real[i].name] = builtin_real[i].value;
+    if ( attached != 0 )
+      for ( map_real_const_iterator ii = attached -> begin();
+            ii != attached -> end(); ++ii )
+        all[ii -> first] = ii -> second;
+    for ( map_real_const_iterator ii = variables . begin();
+          ii != variables . end(); ++ii )
+      all[ii -> first] = ii -> second;
+    return all;
+  }
+
+  template <typename T_type>
+  bool
+  Calculator<T_type>::lookup( string const & name, value_type & val ) const {
+    map_real_const_iterator ii = variables . find(name);
+    if ( ii != variables . end() ) { val = ii -> second; return true; }
+    if ( attached != 0 ) {
+      ii = attached -> find(name);
+      if ( ii != attached -> end() ) { val = ii -> second; return true; }
+    }
+    int ib = builtin_find( builtin_real, n_builtin_real, name.c_str() );
+    if ( ib >= 0 && (dropped_real & (1u<<ib)) == 0 ) {
+      val = builtin_real[ib].value;
+      return true;
+    }
+    return false;
+  }
+
+  template <typename T_type>
+  typename Calculator<T_type>::Func1
+  Calculator<T_type>::find_unary_fun( string const & name ) const {
+    map_fun1_const_iterator f1 = unary_fun . find(name);
+    if ( f1 != unary_fun . end() ) return f1 -> second;
+    int ib = builtin_find( builtin_fun1, n_builtin_fun1, name.c_str() );
+    return ib >= 0 ? builtin_fun1[ib].fun : 0;
+  }
+
+  template <typename T_type>
+  typename Calculator<T_type>::Func2
+  Calculator<T_type>::find_binary_fun( string const & name ) const {
+    map_fun2_const_iterator f2 = binary_fun . find(name);
+    if ( f2 != binary_fun . end() ) return f2 -> second;
+    int ib = builtin_find( builtin_fun2, n_builtin_fun2, name.c_str() );
+    return ib >= 0 ? builtin_fun2[ib].fun : 0;
+  }
+
   template <typename T_type>
   void
   Calculator<T_type>::set( string const & name, value_type val ) {
@@ -357,10 +657,10 @@ namespace calc_defs {
       string var1 = name . substr(0,pos);
       string var2 = name . substr(pos+1);
 
-      map_real_const_iterator ii = variables . find(var2);
-      if ( ii != variables . end() ) {
+      value_type idx;
+      if ( lookup(var2,idx) ) {
 		// build variable
-		to_string( ii -> second, var2 );
+		to_string( idx, var2 );
 		var1 += var2;
 		variables[var1] = val;
       } else {
@@ -381,10 +681,10 @@ namespace calc_defs {
       // split variable in 2
       var1 = name . substr(0,pos);
       var2 = name . substr(pos+1);
-      map_real_const_iterator ii = variables . find(var2);
-      if ( ii != variables . end() ) {
+      value_type idx;
+      if ( lookup(var2,idx) ) {
 		// build variable
-		to_string( ii -> second, var2 );
+		to_string( idx, var2 );
 		var1 += var2;
       } else {
         token_string = var2;
@@ -393,9 +693,9 @@ namespace calc_defs {
     } else {
       var1 = name;
     }
-    map_real_const_iterator ii = variables . find(var1);
-    ok = ii != variables . end();
-    if ( ok ) return ii -> second;
+    value_type val;
+    ok = lookup(var1,val);
+    if ( ok ) return val;
     else      return 0;
   }
 
@@ -493,20 +793,38 @@ namespace calc_defs {
   template <typename T_type>
   void
   Calculator<T_type>::print( ostream & s ) const {
+    // merge builtin and user symbols for an ordered listing
+    map_fun1 all_fun1;
+    map_fun2 all_fun2;
+    map_real all_real = variables_map();
+    int i;
+    for ( i = 0; i < n_builtin_fun1; ++i )
+      all_fun1[builtin_fun1[i].name] = builtin_fun1[i].fun;
+    for ( i = 0; i < n_builtin_fun2; ++i )
+      all_fun2[builtin_fun2[i].name] = builtin_fun2[i].fun;
+    all_fun1 . insert( unary_fun  . begin(), unary_fun  . end() );
+    all_fun2 . insert( binary_fun . begin(), binary_fun . end() );
+    for ( map_obj1_const_iterator o1 = unary_obj . begin();
+          o1 != unary_obj . end(); ++o1 )
+      all_fun1[o1 -> first] = 0;
+    for ( map_obj2_const_iterator o2 = binary_obj . begin();
+          o2 != binary_obj . end(); ++o2 )
+      all_fun2[o2 -> first] = 0;
+
     map_real_const_iterator ii;
     map_fun1_const_iterator f1;
     map_fun2_const_iterator f2;
-  
+
     s << "\nUNARY FUNCTIONS\n";
-    for ( f1 = unary_fun . begin(); f1 != unary_fun . end(); ++f1 )
+    for ( f1 = all_fun1 . begin(); f1 != all_fun1 . end(); ++f1 )
       s << f1 -> first << ", ";
   
     s << "\n\nBINARY FUNCTIONS\n";
-    for ( f2 = binary_fun . begin(); f2 != binary_fun . end(); ++f2 )
+    for ( f2 = all_fun2 . begin(); f2 != all_fun2 . end(); ++f2 )
       s << f2 -> first << ", ";
   
     s << "\n\nVARIABLES\n";
-    for ( ii = variables . begin(); ii != variables . end(); ++ii )
+    for ( ii = all_real . begin(); ii != all_real . end(); ++ii )
       s << ii -> first << " = " << ii -> second << "\n";
   
     s << "END LIST\n";
@@ -619,19 +937,21 @@ namespace calc_defs {
         return res;
       }
   
-      map_fun1_iterator f1 = unary_fun . find(token_string);
-      if ( f1 != unary_fun . end() ) {
+      Object1 * o1 = find_unary_obj(token_string);
+      Func1     f1 = o1 == 0 ? find_unary_fun(token_string) : 0;
+      if ( o1 != 0 || f1 != 0 ) {
         Next_Token(); // expect (
         if ( token_type != OpenPar ) throw Expected_OpenPar;
         Next_Token(); // eat (
         value_type v1 = G0();
         if ( token_type != ClosePar ) throw Expected_ClosePar;
         Next_Token(); // eat )
-        return f1 -> second(v1);
+        return o1 != 0 ? o1 -> eval(v1) : f1(v1);
       }
   
-      map_fun2_iterator f2 = binary_fun . find(token_string);
-      if ( f2 != binary_fun . end() ) {
+      Object2 * o2 = find_binary_obj(token_string);
+      Func2     f2 = o2 == 0 ? find_binary_fun(token_string) : 0;
+      if ( o2 != 0 || f2 != 0 ) {
         Next_Token(); // expect (
         if ( token_type != OpenPar ) throw Expected_OpenPar;
         Next_Token(); // eat (
@@ -641,7 +961,7 @@ namespace calc_defs {
         value_type v2 = G0();
         if ( token_type != ClosePar ) throw Expected_ClosePar;
         Next_Token(); // eat )
-        return f2 -> second(v1,v2);
+        return o2 != 0 ? o2 -> eval(v1,v2) : f2(v1,v2);
       }
   
       throw Unknown_Variable;
@@ -727,6 +1047,8 @@ namespace calc_defs {
 
 namespace calc_load {
   using calc_defs::Calculator;
+  using calc_defs::Unary_function;
+  using calc_defs::Binary_function;
 }
 
 #endif
@@ -0,0 +1,690 @@
+/*--------------------------------------------------------------------------*\
+ |                                                                          |
+ |  This program is free software; you can redistribute it and/or modify    |
+ |  it under the terms of the GNU General Public License as published by    |
+ |  the Free Software Foundation; either version 2, or (at your option)     |
+ |  any later version.                                                      |
+ |                                                                          |
+ |  This program is distributed in the hope that it will be useful,         |
+ |  but WITHOUT ANY WARRANTY; without even the implied warranty of          |
+ |  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           |
+ |  GNU General Public License for more details.                            |
+ |                                                                          |
+ |  You should have received a copy of the GNU General Public License       |
+ |  along with this program; if not, write to the Free Software             |
+ |  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.               |
+ |                                                                          |
+ |  Copyright (C) 1999                                                      |
+ |                                                                          |
+ |            ___    ____  ___  __  __        ___    ____  ___  __  __      |
+ |           /   \  /     /   \  \  /        /   \  /     /   \  \  /       |
+ |          /____/ /__   /____/   \/        /____/ /__   /____/   \/        |
+ |         /   \  /     /   \     /        /   \  /     /   \     /         |
+ |        /____/ /____ /    /    /        /____/ /____ /    /    /          |
+ |                                                                          |
+ |      Enrico Bertolazzi                                                   |
+ |      Dipartimento di Ingegneria Meccanica e Strutturale                  |
+ |      Universita` degli Studi di Trento                                   |
+ |      Via Mesiano 77, I-38050 Trento, Italy                               |
+ |                                                                          |
+\*--------------------------------------------------------------------------*/
+
+
+#ifndef CALC_BATCH_HH
+#define CALC_BATCH_HH
+
+#include "calc.hh"
+#include "calc_simd.hh"
+
+#include <limits>
+#include <vector>
+
+namespace calc_defs {
+
+  using namespace ::std;
+
+  /*!
+   * Array versions of the builtin functions, for `double` they are
+   * the vectorized kernels of `calc_simd.hh`
+   */
+  template <typename T_type>
+  struct Bulk_builtins {
+    typedef void (*Kernel1)( int, T_type const *, T_type * );
+    typedef void (*Kernel2)( int, T_type const *, T_type const *, T_type * );
+    static Kernel1 unary  ( char const * ) { return 0; }
+    static Kernel2 binary ( char const * ) { return 0; }
+  };
+
+  template <>
+  struct Bulk_builtins<double> {
+    typedef simd::Kernel1 Kernel1;
+    typedef simd::Kernel2 Kernel2;
+    static Kernel1 unary  ( char const * name ) { return simd::unary(name);  }
+    static Kernel2 binary ( char const * name ) { return simd::binary(name); }
+  };
+
+  /*!
+   * This class compiles an expression with the grammar of Calculator
+   * into a sequence of operations on arrays, then evaluates it on
+   * many rows at once.  Some variables are inputs, taking a different
+   * value on each row; the other variables are read from the
+   * evaluator when compiling.  Variables assigned by the expression
+   * are kept per row.  The rows are processed in blocks, calling the
+   * array version of each function once per block.  A power with a
+   * constant exponent that is an integer between -max_powi and
+   * max_powi, or 0.5, does not call `pow` (except for negative
+   * exponents on the rows where the power is not a normal number).
+   */
+  template <typename T_type = double>
+  class Program {
+
+  public:
+
+    typedef T_type                 value_type;
+    typedef value_type*            pointer;
+    typedef const value_type*      const_pointer;
+    typedef Calculator<value_type> CALCULATOR;
+
+    typedef typename CALCULATOR::Func1   Func1;
+    typedef typename CALCULATOR::Func2   Func2;
+    typedef typename CALCULATOR::Object1 Object1;
+    typedef typename CALCULATOR::Object2 Object2;
+
+    typedef typename Bulk_builtins<value_type>::Kernel1 Kernel1;
+    typedef typename Bulk_builtins<value_type>::Kernel2 Kernel2;
+
+    //! number of rows processed at once
+    enum { block_size = 256 };
+
+    //! scratch memory for the evaluation, one for each thread
+    typedef vector<value_type> Workspace;
+
+  private:
+
+    typedef typename CALCULATOR::Token_Type Token_Type;
+    typedef typename CALCULATOR::ErrorCode  ErrorCode;
+
+    typedef enum {
+      Op_const, Op_input, Op_load, Op_store, Op_pop,
+      Op_neg, Op_add, Op_sub, Op_mul, Op_div, Op_pow,
+      Op_powi, Op_sqrt, Op_fun1, Op_fun2
+    } Op_code;
+
+    // `x^n` with a constant integer |n| <= max_powi is computed by
+    // multiplications, `x^0.5` by the square root
+    enum { max_powi = 8 };
+
+    typedef struct {
+      Op_code    code;
+      int        arg;   // input or slot index
+      value_type value;
+      Func1      f1;
+      Func2      f2;
+      Object1 *  o1;
+      Object2 *  o2;
+      Kernel1    k1;
+      Kernel2    k2;
+    } Instruction;
+
+    vector<Instruction> code;
+    vector<string>      input_names;
+    vector<string>      slot_names;
+    int                 depth, max_depth;
+    CALCULATOR *        ee; // valid while compiling
+
+    void emit( Op_code c, int arg = 0, value_type value = 0 );
+    bool constant_since( size_t mark, value_type & value ) const;
+    int  find_name( vector<string> const & names, string const & name ) const;
+    void resolve_name( string const & name, string & res );
+
+    void C0(void);
+    void C1(void);
+    void C2(void);
+    void C3(void);
+    void C4(void);
+    void C5(void);
+
+    void
+    eval_block(
+      int                   n,
+      const_pointer const   inputs[],
+      size_t                offset,
+      pointer               result,
+      char *                err,
+      pointer const         slots_out[],
+      pointer               ws
+    ) const;
+
+  public:
+
+    Program()
+    : code()
+    , input_names()
+    , slot_names()
+    , depth(0)
+    , max_depth(0)
+    , ee(0)
+    {}
+
+    /*!
+     *  Compile an expression, possibly with many statements separated
+     *  by `;`, the value of the last statement is the result.
+     *  \param calc   the evaluator with the functions and the variables,
+     *                on error `calc.report_error` describes it
+     *  \param str    the expression
+     *  \param inputs the names of the variables taking a value per row
+     *  \return true if no error is found
+     */
+    bool compile( CALCULATOR & calc, char const * str, vector<string> const & inputs );
+
+    bool
+    compile( CALCULATOR & calc, string const & str, vector<string> const & inputs )
+    { return compile( calc, str.c_str(), inputs ); }
+
+    //! \return the names of the inputs
+    vector<string> const & inputs() const { return input_names; }
+
+    //! \return the names of the variables assigned by the program
+    vector<string> const & assigned() const { return slot_names; }
+
+    //! \return the size of the scratch memory needed by `eval`
+    size_t workspace_size() const { return size_t(max_depth+slot_names.size())*block_size; }
+
+    /*!
+     *  Evaluate the program on `n` rows
+     *  \param n         number of rows
+     *  \param inputs    `inputs[j][i]` is the value of the input `j` at row `i`
+     *  \param result    the result for each row
+     *  \param err       if not null, `err[i]` is set to 1 if an error
+     *                   (division by zero) is found on row `i`, 0 otherwise
+     *  \param ws        scratch memory, resized if needed
+     *  \param slots_out if not null, `slots_out[k][i]` (when not null)
+     *                   receives the value of the variable `assigned()[k]`
+     *  \return the number of rows with errors
+     */
+    size_t
+    eval(
+      size_t              n,
+      const_pointer const inputs[],
+      pointer             result,
+      char *              err,
+      Workspace &         ws,
+      pointer const       slots_out[] = 0
+    ) const;
+
+  };
+
+  template <typename T_type>
+  void
+  Program<T_type>::emit( Op_code c, int arg, value_type value ) {
+    Instruction ins;
+    ins.code  = c;
+    ins.arg   = arg;
+    ins.value = value;
+    ins.f1    = 0;
+    ins.f2    = 0;
+    ins.o1    = 0;
+    ins.o2    = 0;
+    ins.k1    = 0;
+    ins.k2    = 0;
+    code.push_back(ins);
+    switch ( c ) {
+    case Op_const: case Op_input: case Op_load:
+      if ( ++depth > max_depth ) max_depth = depth;
+      break;
+    case Op_add: case Op_sub: case Op_mul: case Op_div: case Op_pow: case Op_fun2:
+    case Op_pop:
+      --depth;
+      break;
+    default:
+      break;
+    }
+  }
+
+  // true if the code emitted from `mark` is a constant, possibly negated
+  template <typename T_type>
+  bool
+  Program<T_type>::constant_since( size_t mark, value_type & value ) const {
+    if ( code . size() == mark+1 && code[mark] . code == Op_const )
+      { value = code[mark] . value; return true; }
+    if ( code . size() == mark+2 && code[mark] . code == Op_const &&
+         code[mark+1] . code == Op_neg )
+      { value = -code[mark] . value; return true; }
+    return false;
+  }
+
+  template <typename T_type>
+  int
+  Program<T_type>::find_name( vector<string> const & names, string const & name ) const {
+    for ( size_t i = 0; i < names.size(); ++i )
+      if ( names[i] == name ) return int(i);
+    return -1;
+  }
+
+  // build the name of the variables `name@idx`, idx must be a constant
+  template <typename T_type>
+  void
+  Program<T_type>::resolve_name( string const & name, string & res ) {
+    string::size_type pos = name . find('@');
+    if ( pos == string::npos ) { res = name; return; }
+    string var2 = name . substr(pos+1);
+    value_type idx;
+    if ( find_name( slot_names, var2 )  >= 0 ||
+         find_name( input_names, var2 ) >= 0 ||
+         !ee -> lookup( var2, idx ) ) {
+      ee -> token_string = var2;
+      throw CALCULATOR::Unknown_Variable;
+    }
+    ee -> to_string( idx, var2 );
+    res = name . substr(0,pos) + var2;
+  }
+
+  template <typename T_type>
+  bool
+  Program<T_type>::compile(
+    CALCULATOR &           calc,
+    char const *           str,
+    vector<string> const & inputs
+  ) {
+    code . clear();
+    slot_names . clear();
+    input_names = inputs;
+    depth = max_depth = 0;
+    ee = &calc;
+
+    ee -> string_in   = ee -> ptr = str;
+    ee -> error_found = CALCULATOR::No_Error;
+    try {
+      bool empty = true;
+      do { ee -> Next_Token(); } while ( ee -> token_type == CALCULATOR::EndOfExpression );
+      while ( ee -> token_type != CALCULATOR::EndOfString ) {
+        // the value of the statement replaces the previous one
+        if ( !empty ) emit( Op_pop );
+        C0();
+        empty = false;
+        while ( ee -> token_type == CALCULATOR::EndOfExpression ) ee -> Next_Token();
+      }
+      if ( empty ) emit( Op_const, 0, 0 );
+    }
+    catch ( ErrorCode err ) {
+      ee -> error_found = err;
+    }
+    catch (...) {
+      ee -> error_found = CALCULATOR::Unknown_Error;
+    }
+    ee = 0;
+    if ( calc.error_found != CALCULATOR::No_Error ) {
+      code . clear();
+      return false;
+    }
+    return true;
+  }
+
+  // handle assignments, same structure of Calculator::G0
+  template <typename T_type>
+  void
+  Program<T_type>::C0() {
+
+    if ( ee -> token_type == CALCULATOR::EndOfExpression ||
+         ee -> token_type == CALCULATOR::EndOfString ) {
+      emit( Op_const, 0, 0 );
+      return;
+    }
+
+    char const * const bf_ptr = ee -> ptr; // save pointer
+    string     name  = ee -> token_string;
+    Token_Type token = ee -> token_type;
+
+    if ( ee -> token_type == CALCULATOR::Variable ) {
+      ee -> Next_Token();
+      if ( ee -> token_type == CALCULATOR::Assign ) {
+        ee -> Next_Token();
+        C1();
+        string var;
+        resolve_name( name, var );
+        int k = find_name( slot_names, var );
+        if ( k < 0 ) {
+          k = int(slot_names . size());
+          slot_names . push_back( var );
+        }
+        emit( Op_store, k );
+        return;
+      }
+    }
+
+    ee -> ptr          = bf_ptr; // restore pointer
+    ee -> token_string = name;
+    ee -> token_type   = token;
+
+    C1();
+  }
+
+  template <typename T_type>
+  void
+  Program<T_type>::C1() {
+    C2();
+    while ( ee -> token_type == CALCULATOR::Plus ||
+            ee -> token_type == CALCULATOR::Minus ) {
+      bool do_plus = ee -> token_type == CALCULATOR::Plus;
+      ee -> Next_Token();
+      C2();
+      emit( do_plus ? Op_add : Op_sub );
+    }
+  }
+
+  template <typename T_type>
+  void
+  Program<T_type>::C2() {
+    C3();
+    while ( ee -> token_type == CALCULATOR::Times ||
+            ee -> token_type == CALCULATOR::Divide ) {
+      bool do_times = ee -> token_type == CALCULATOR::Times;
+      ee -> Next_Token();
+      C3();
+      emit( do_times ? Op_mul : Op_div );
+    }
+  }
+
+  template <typename T_type>
+  void
+  Program<T_type>::C3() {
+    C4();
+    if ( ee -> token_type == CALCULATOR::Power ) {
+      ee -> Next_Token();
+      size_t     mark = code . size();
+      value_type e;
+      C4();
+      if ( constant_since( mark, e ) ) {
+        int ie = int(e);
+        if ( value_type(ie) == e && ie >= -max_powi && ie <= max_powi ) {
+          code . resize( mark );
+          --depth;
+          emit( Op_powi, ie );
+          return;
+        }
+        if ( e == value_type(0.5) ) {
+          code . resize( mark );
+          --depth;
+          emit( Op_sqrt );
+          code . back() . k1 = Bulk_builtins<value_type>::unary( "sqrt" );
+          return;
+        }
+      }
+      emit( Op_pow );
+      code . back() . f2 = pow;
+      code . back() . k2 = Bulk_builtins<value_type>::binary( "pow" );
+    }
+  }
+
+  template <typename T_type>
+  void
+  Program<T_type>::C4() {
+    if ( ee -> token_type == CALCULATOR::Minus ) {
+      ee -> Next_Token();
+      C5();
+      emit( Op_neg );
+      return;
+    }
+    if ( ee -> token_type == CALCULATOR::Plus ) ee -> Next_Token();
+    C5();
+  }
+
+  template <typename T_type>
+  void
+  Program<T_type>::C5() {
+    if ( ee -> token_type == CALCULATOR::OpenPar ) {
+      ee -> Next_Token(); // eat (
+      C0();
+      if ( ee -> token_type != CALCULATOR::ClosePar ) throw CALCULATOR::Expected_ClosePar;
+      ee -> Next_Token(); // eat )
+      return;
+    }
+
+    if ( ee -> token_type == CALCULATOR::Number ) {
+      value_type val;
+      ee -> get_number( val, ee -> token_string );
+      ee -> Next_Token();
+      emit( Op_const, 0, val );
+      return;
+    }
+
+    if ( ee -> token_type == CALCULATOR::Variable ) {
+
+      string var;
+      resolve_name( ee -> token_string, var );
+
+      // variables: assigned in the program, inputs, then constants
+      int k = find_name( slot_names, var );
+      if ( k >= 0 ) { ee -> Next_Token(); emit( Op_load, k ); return; }
+      k = find_name( input_names, var );
+      if ( k >= 0 ) { ee -> Next_Token(); emit( Op_input, k ); return; }
+      value_type val;
+      if ( ee -> lookup( var, val ) ) {
+        ee -> Next_Token();
+        emit( Op_const, 0, val );
+        return;
+      }
+
+      string    name = ee -> token_string;
+      bool      user = ee -> unary_fun . find(name) != ee -> unary_fun . end();
+      Object1 * o1   = ee -> find_unary_obj(name);
+      Func1     f1   = o1 == 0 ? ee -> find_unary_fun(name) : 0;
+      if ( o1 != 0 || f1 != 0 ) {
+        ee -> Next_Token(); // expect (
+        if ( ee -> token_type != CALCULATOR::OpenPar ) throw CALCULATOR::Expected_OpenPar;
+        ee -> Next_Token(); // eat (
+        C0();
+        if ( ee -> token_type != CALCULATOR::ClosePar ) throw CALCULATOR::Expected_ClosePar;
+        ee -> Next_Token(); // eat )
+        emit( Op_fun1 );
+        code . back() . f1 = f1;
+        code . back() . o1 = o1;
+        if ( !user && o1 == 0 )
+          code . back() . k1 = Bulk_builtins<value_type>::unary( name.c_str() );
+        return;
+      }
+
+      user = ee -> binary_fun . find(name) != ee -> binary_fun . end();
+      Object2 * o2 = ee -> find_binary_obj(name);
+      Func2     f2 = o2 == 0 ? ee -> find_binary_fun(name) : 0;
+      if ( o2 != 0 || f2 != 0 ) {
+        ee -> Next_Token(); // expect (
+        if ( ee -> token_type != CALCULATOR::OpenPar ) throw CALCULATOR::Expected_OpenPar;
+        ee -> Next_Token(); // eat (
+        C0();
+        if ( ee -> token_type != CALCULATOR::Comma ) throw CALCULATOR::Expected_Comma;
+        ee -> Next_Token(); // eat ,
+        C0();
+        if ( ee -> token_type != CALCULATOR::ClosePar ) throw CALCULATOR::Expected_ClosePar;
+        ee -> Next_Token(); // eat )
+        emit( Op_fun2 );
+        code . back() . f2 = f2;
+        code . back() . o2 = o2;
+        if ( !user && o2 == 0 )
+          code . back() . k2 = Bulk_builtins<value_type>::binary( name.c_str() );
+        return;
+      }
+
+      throw CALCULATOR::Unknown_Variable;
+    }
+    throw CALCULATOR::Bad_Position;
+  }
+
+  template <typename T_type>
+  void
+  Program<T_type>::eval_block(
+    int                 n,
+    const_pointer const inputs[],
+    size_t              offset,
+    pointer             result,
+    char *              err,
+    pointer const       slots_out[],
+    pointer             ws
+  ) const {
+    // S[d] is the scratch buffer of the stack level d, top[d] points to
+    // the values of the level (scratch, input column or slot)
+    pointer       slot0 = ws + size_t(max_depth)*block_size;
+    const_pointer top[64];
+    vector<const_pointer> top_big;
+    const_pointer * tp = top;
+    if ( max_depth > 64 ) { top_big . resize(max_depth); tp = &top_big.front(); }
+
+    int d = 0;
+    for ( size_t ic = 0; ic < code.size(); ++ic ) {
+      Instruction const & ins = code[ic];
+      pointer S = ws + size_t(d > 0 ? d-1 : 0)*block_size; // level of the result
+      switch ( ins.code ) {
+      case Op_const:
+        S = ws + size_t(d)*block_size;
+        for ( int i = 0; i < n; ++i ) S[i] = ins.value;
+        tp[d++] = S;
+        break;
+      case Op_input:
+        tp[d++] = inputs[ins.arg] + offset;
+        break;
+      case Op_load:
+        tp[d++] = slot0 + size_t(ins.arg)*block_size;
+        break;
+      case Op_store:
+        {
+          pointer slot = slot0 + size_t(ins.arg)*block_size;
+          if ( tp[d-1] != slot ) {
+            // the levels below keep the old values of the variable
+            for ( int j = 0; j < d-1; ++j )
+              if ( tp[j] == slot ) {
+                pointer Sj = ws + size_t(j)*block_size;
+                for ( int i = 0; i < n; ++i ) Sj[i] = slot[i];
+                tp[j] = Sj;
+              }
+            for ( int i = 0; i < n; ++i ) slot[i] = tp[d-1][i];
+          }
+          tp[d-1] = slot;
+        }
+        break;
+      case Op_pop:
+        --d;
+        break;
+      case Op_neg:
+        for ( int i = 0; i < n; ++i ) S[i] = -tp[d-1][i];
+        tp[d-1] = S;
+        break;
+      case Op_powi:
+        {
+          // binary powering, one pass per bit of the exponent
+          value_type P[block_size], X[block_size];
+          int        m = ins.arg < 0 ? -ins.arg : ins.arg;
+          for ( int i = 0; i < n; ++i ) P[i] = X[i] = tp[d-1][i];
+          for ( int i = 0; i < n; ++i ) S[i] = 1;
+          for ( ; m > 0; m >>= 1 ) {
+            if ( m & 1 ) for ( int i = 0; i < n; ++i ) S[i] *= P[i];
+            if ( m > 1 ) for ( int i = 0; i < n; ++i ) P[i] *= P[i];
+          }
+          if ( ins.arg < 0 ) {
+            // the reciprocal of an overflowed, zero or subnormal power
+            // is wrong where pow gives a subnormal, use pow there
+            value_type const lo = numeric_limits<value_type>::min();
+            value_type const hi = numeric_limits<value_type>::max();
+            for ( int i = 0; i < n; ++i ) {
+              value_type r = abs( S[i] );
+              S[i] = r >= lo && r <= hi ? 1/S[i] : pow( X[i], value_type(ins.arg) );
+            }
+          }
+          tp[d-1] = S;
+        }
+        break;
+      case Op_sqrt:
+        {
+          // as pow: (-0)^0.5 = +0 and (-inf)^0.5 = +inf
+          value_type const inf = numeric_limits<value_type>::infinity();
+          const_pointer    a   = tp[d-1];
+          char             minf[block_size];
+          bool             any = false;
+          for ( int i = 0; i < n; ++i ) any |= ( minf[i] = a[i] == -inf );
+          if ( ins.k1 != 0 ) ins.k1( n, a, S );
+          else for ( int i = 0; i < n; ++i ) S[i] = sqrt( a[i] );
+          for ( int i = 0; i < n; ++i ) S[i] += 0;
+          if ( any ) for ( int i = 0; i < n; ++i ) if ( minf[i] ) S[i] = inf;
+          tp[d-1] = S;
+        }
+        break;
+      case Op_add:
+      case Op_sub:
+      case Op_mul:
+      case Op_div:
+      case Op_pow:
+      case Op_fun2:
+        {
+          const_pointer a = tp[d-2], b = tp[d-1];
+          S = ws + size_t(d-2)*block_size;
+          switch ( ins.code ) {
+          case Op_add: for ( int i = 0; i < n; ++i ) S[i] = a[i] + b[i]; break;
+          case Op_sub: for ( int i = 0; i < n; ++i ) S[i] = a[i] - b[i]; break;
+          case Op_mul: for ( int i = 0; i < n; ++i ) S[i] = a[i] * b[i]; break;
+          case Op_div:
+            for ( int i = 0; i < n; ++i ) {
+              if ( b[i] == 0 ) err[i] = 1;
+              S[i] = a[i] / b[i];
+            }
+            break;
+          default:
+            if      ( ins.k2 != 0 ) ins.k2( n, a, b, S );
+            else if ( ins.o2 != 0 ) ins.o2 -> eval( n, a, b, S );
+            else for ( int i = 0; i < n; ++i ) S[i] = ins.f2( a[i], b[i] );
+            break;
+          }
+          tp[--d-1] = S;
+        }
+        break;
+      case Op_fun1:
+        if      ( ins.k1 != 0 ) ins.k1( n, tp[d-1], S );
+        else if ( ins.o1 != 0 ) ins.o1 -> eval( n, tp[d-1], S );
+        else for ( int i = 0; i < n; ++i ) S[i] = ins.f1( tp[d-1][i] );
+        tp[d-1] = S;
+        break;
+      }
+    }
+
+    for ( int i = 0; i < n; ++i ) result[i] = tp[0][i];
+    if ( slots_out != 0 )
+      for ( size_t k = 0; k < slot_names.size(); ++k )
+        if ( slots_out[k] != 0 ) {
+          const_pointer slot = slot0 + k*block_size;
+          for ( int i = 0; i < n; ++i ) slots_out[k][offset+i] = slot[i];
+        }
+  }
+
+  template <typename T_type>
+  size_t
+  Program<T_type>::eval(
+    size_t              n,
+    const_pointer const inputs[],
+    pointer             result,
+    char *              err,
+    Workspace &         ws,
+    pointer const       slots_out[]
+  ) const {
+    if ( code . empty() ) return n; // not compiled
+    if ( ws . size() < workspace_size() ) ws . resize( workspace_size() );
+    char   errbuf[block_size];
+    size_t nerr = 0;
+    for ( size_t offset = 0; offset < n; offset += block_size ) {
+      int nb = int( n-offset < size_t(block_size) ? n-offset : size_t(block_size) );
+      memset( errbuf, 0, nb );
+      eval_block( nb, inputs, offset, result+offset, errbuf, slots_out, &ws.front() );
+      for ( int i = 0; i < nb; ++i ) nerr += errbuf[i];
+      if ( err != 0 ) memcpy( err+offset, errbuf, nb );
+    }
+    return nerr;
+  }
+
+  // end class Program
+
+} // end namespace
+
+namespace calc_load {
+  using calc_defs::Program;
+}
+
+#endif
+
+// end of file: calc_batch.hh
@@ -0,0 +1,396 @@
+/*--------------------------------------------------------------------------*\
+ |                                                                          |
+ |  This program is free software; you can redistribute it and/or modify    |
+ |  it under the terms of the GNU General Public License as published by    |
+ |  the Free Software Foundation; either version 2, or (at your option)     |
+ |  any later version.                                                      |
+ |                                                                          |
+ |  This program is distributed in the hope that it will be useful,         |
+ |  but WITHOUT ANY WARRANTY; without even the implied warranty of          |
+ |  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           |
+ |  GNU General Public License for more details.                            |
+ |                                                                          |
+ |  You should have received a copy of the GNU General Public License       |
+ |  along with this program; if not, write to the Free Software             |
+ |  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.               |
+ |                                                                          |
+ |  Copyright (C) 1999                                                      |
+ |                                                                          |
+ |            ___    ____  ___  __  __        ___    ____  ___  __  __      |
+ |           /   \  /     /   \  \  /        /   \  /     /   \  \  /       |
+ |          /____/ /__   /____/   \/        /____/ /__   /____/   \/        |
+ |         /   \  /     /   \     /        /   \  /     /   \     /         |
+ |        /____/ /____ /    /    /        /____/ /____ /    /    /          |
+ |                                                                          |
+ |      Enrico Bertolazzi                                                   |
+ |      Dipartimento di Ingegneria Meccanica e Strutturale                  |
+ |      Universita` degli Studi di Trento                                   |
+ |      Via Mesiano 77, I-38050 Trento, Italy                               |
+ |                                                                          |
+\*--------------------------------------------------------------------------*/
+
+
+#ifndef CALC_COLUMNS_HH
+#define CALC_COLUMNS_HH
+
+#include "calc.hh"
+#include "calc_batch.hh"
+
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+namespace calc_defs {
+
+  using namespace ::std;
+
+  /*!
+   * Evaluation of a set of definitions `name = expr` over columns of
+   * data, e.g. read from CSV files.  The input columns are the
+   * variables taking a value per row, the output columns are the
+   * variables assigned by the definitions.
+   *
+   * The data are processed in chunks: a chunk of CSV text (whole
+   * lines) is parsed, evaluated and formatted by `csv_chunk`, which
+   * does not modify the object, so the chunks can be processed by many
+   * threads, each with its own `Buffer`.
+   */
+  template <typename T_type = double>
+  class Columns {
+
+  public:
+
+    typedef T_type                 value_type;
+    typedef value_type*            pointer;
+    typedef const value_type*      const_pointer;
+    typedef Calculator<value_type> CALCULATOR;
+    typedef Program<value_type>    PROGRAM;
+
+    //! scratch memory for the evaluation of a chunk, one for each thread
+    typedef struct {
+      vector<vector<value_type> > in;      //!< input columns
+      vector<vector<value_type> > out;     //!< output columns
+      vector<const_pointer>       in_ptr;
+      vector<pointer>             out_ptr;
+      vector<value_type>          result;
+      vector<char>                err;     //!< 1 on the rows with errors
+      typename PROGRAM::Workspace ws;
+    } Buffer;
+
+  private:
+
+    PROGRAM        prog;
+    string         missing_output;
+    vector<string> out_names;
+    vector<int>    out_slots;
+    char           delim;
+    int            digits;
+    bool           keep;
+
+    static value_type
+    nan_value()
+    { return numeric_limits<value_type>::quiet_NaN(); }
+
+    void format( value_type v, string & s ) const;
+
+  public:
+
+    Columns()
+    : prog()
+    , missing_output()
+    , out_names()
+    , out_slots()
+    , delim(',')
+    , digits(numeric_limits<value_type>::digits10+2)
+    , keep(false)
+    {}
+
+    //! field separator of the CSV text (default `,`)
+    void set_delimiter( char d ) { delim = d; }
+
+    //! significant digits of the CSV output (default: enough to read back the value)
+    void set_digits( int d ) { digits = d; }
+
+    //! if true the input columns are copied before the outputs in the CSV output
+    void set_keep_inputs( bool k ) { keep = k; }
+
+    /*!
+     *  Compile the definitions.
+     *  \param ee      the evaluator with the functions and the constants,
+     *                 on a syntax error `ee.report_error` describes it
+     *  \param defs    the definitions, separated by `;`
+     *  \param inputs  the names of the input columns
+     *  \param outputs the names of the output columns, if empty all the
+     *                 variables assigned by the definitions
+     *  \return true if no error is found
+     */
+    bool
+    compile(
+      CALCULATOR &           ee,
+      string const &         defs,
+      vector<string> const & inputs,
+      vector<string> const & outputs
+    );
+
+    //! \return the output not assigned by the definitions, if `compile` failed for it
+    string const & missing() const { return missing_output; }
+
+    //! \return the names of the input columns
+    vector<string> const & inputs() const { return prog . inputs(); }
+
+    //! \return the names of the output columns
+    vector<string> const & outputs() const { return out_names; }
+
+    /*!
+     *  Evaluate `n` rows.
+     *  \param n   number of rows
+     *  \param in  `in[j][i]` is the value of the input `j` at row `i`
+     *  \param buf scratch memory, the outputs are in `buf.out` and
+     *             `buf.in_ptr` is set to `in`
+     *  \return the number of rows with errors, their outputs are `NaN`
+     */
+    size_t eval( size_t n, const_pointer const in[], Buffer & buf ) const;
+
+    /*!
+     *  Split the names of the header line of a CSV text.
+     *  \return the position after the header line
+     */
+    char const *
+    csv_header( char const * begin, char const * end, vector<string> & names ) const;
+
+    //! the header line of the CSV output
+    void csv_header( string & s ) const;
+
+    /*!
+     *  Find the end of a chunk of whole lines.
+     *  \return the position after the first new line at or after
+     *          `begin+size`, `end` if none
+     */
+    static char const *
+    chunk_end( char const * begin, char const * end, size_t size );
+
+    /*!
+     *  Parse whole lines of CSV text into `buf.in`, fields which are
+     *  empty or not numbers are `NaN`, empty lines are skipped.
+     *  \return the number of rows
+     */
+    size_t csv_parse( char const * begin, char const * end, Buffer & buf ) const;
+
+    /*!
+     *  Append `n` rows of CSV text with the outputs of `buf`
+     *  (preceded by the inputs if `set_keep_inputs(true)`).
+     */
+    void csv_format( size_t n, Buffer const & buf, string & s ) const;
+
+    /*!
+     *  Parse, evaluate and format a chunk of whole lines of CSV text.
+     *  \param begin, end the text
+     *  \param s          the output text is appended here
+     *  \param buf        scratch memory
+     *  \param n_err      incremented by the number of rows with errors
+     *  \return the number of rows
+     */
+    size_t
+    csv_chunk(
+      char const * begin,
+      char const * end,
+      string &     s,
+      Buffer &     buf,
+      size_t &     n_err
+    ) const;
+
+  };
+
+  template <typename T_type>
+  bool
+  Columns<T_type>::compile(
+    CALCULATOR &           ee,
+    string const &         defs,
+    vector<string> const & inputs,
+    vector<string> const & outputs
+  ) {
+    missing_output . clear();
+    out_names . clear();
+    out_slots . clear();
+    if ( !prog . compile( ee, defs, inputs ) ) return false;
+    vector<string> const & slots = prog . assigned();
+    out_names = outputs . empty() ? slots : outputs;
+    for ( size_t k = 0; k < out_names . size(); ++k ) {
+      int j = 0;
+      while ( j < int(slots . size()) && slots[j] != out_names[k] ) ++j;
+      if ( j == int(slots . size()) ) {
+        missing_output = out_names[k];
+        out_names . clear();
+        out_slots . clear();
+        return false;
+      }
+      out_slots . push_back( j );
+    }
+    return true;
+  }
+
+  template <typename T_type>
+  size_t
+  Columns<T_type>::eval( size_t n, const_pointer const in[], Buffer & buf ) const {
+    size_t n_in    = prog . inputs() . size();
+    size_t n_slots = prog . assigned() . size();
+    if ( n_in > 0 && ( buf . in_ptr . empty() || in != &buf . in_ptr . front() ) )
+      buf . in_ptr . assign( in, in+n_in );
+    buf . out . resize( out_names . size() );
+    buf . out_ptr . assign( n_slots, pointer(0) );
+    for ( size_t k = 0; k < out_names . size(); ++k ) {
+      buf . out[k] . resize( n );
+      buf . out_ptr[out_slots[k]] = n > 0 ? &buf . out[k] . front() : 0;
+    }
+    buf . result . resize( n );
+    buf . err . resize( n );
+    if ( n == 0 ) return 0;
+    size_t n_err = prog . eval( n, in, &buf . result . front(), &buf . err . front(),
+                                buf . ws, n_slots > 0 ? &buf . out_ptr . front() : 0 );
+    if ( n_err > 0 )
+      for ( size_t i = 0; i < n; ++i )
+        if ( buf . err[i] )
+          for ( size_t k = 0; k < out_names . size(); ++k )
+            buf . out[k][i] = nan_value();
+    return n_err;
+  }
+
+  template <typename T_type>
+  char const *
+  Columns<T_type>::csv_header(
+    char const *     begin,
+    char const *     end,
+    vector<string> & names
+  ) const {
+    names . clear();
+    char const * eol = begin;
+    while ( eol < end && *eol != '\n' ) ++eol;
+    char const * p = begin;
+    for (;;) {
+      char const * q = p;
+      while ( q < eol && *q != delim ) ++q;
+      char const * b = p, * e = q;
+      while ( b < e && ( isspace(*b) || *b == '"' ) ) ++b;
+      while ( e > b && ( isspace(e[-1]) || e[-1] == '"' ) ) --e;
+      names . push_back( string(b,e) );
+      if ( q == eol ) break;
+      p = q+1;
+    }
+    return eol < end ? eol+1 : end;
+  }
+
+  template <typename T_type>
+  void
+  Columns<T_type>::csv_header( string & s ) const {
+    vector<string> const & in = prog . inputs();
+    bool first = true;
+    if ( keep )
+      for ( size_t j = 0; j < in . size(); ++j, first = false )
+        { if ( !first ) s += delim; s += in[j]; }
+    for ( size_t k = 0; k < out_names . size(); ++k, first = false )
+      { if ( !first ) s += delim; s += out_names[k]; }
+    s += '\n';
+  }
+
+  template <typename T_type>
+  char const *
+  Columns<T_type>::chunk_end( char const * begin, char const * end, size_t size ) {
+    if ( size_t(end-begin) <= size ) return end;
+    char const * p = begin+size;
+    while ( p < end && *p != '\n' ) ++p;
+    return p < end ? p+1 : end;
+  }
+
+  template <typename T_type>
+  size_t
+  Columns<T_type>::csv_parse( char const * begin, char const * end, Buffer & buf ) const {
+    size_t n_in = prog . inputs() . size();
+    buf . in . resize( n_in );
+    for ( size_t j = 0; j < n_in; ++j ) buf . in[j] . clear();
+    // the fields are copied to be parsed, the text may be not terminated
+    char   field[64];
+    size_t n = 0;
+    for ( char const * p = begin; p < end; ) {
+      char const * eol = p;
+      while ( eol < end && *eol != '\n' ) ++eol;
+      char const * q = p;
+      while ( q < eol && isspace(*q) ) ++q;
+      if ( q < eol ) {
+        for ( size_t j = 0; j < n_in; ++j ) {
+          char const * f = p;
+          while ( p < eol && *p != delim ) ++p;
+          size_t len = size_t(p-f);
+          value_type v = nan_value();
+          if ( len > 0 && len < sizeof(field) ) {
+            memcpy( field, f, len );
+            field[len] = '\0';
+            char * ep;
+            double d = strtod( field, &ep );
+            while ( isspace(*ep) ) ++ep;
+            if ( ep != field && *ep == '\0' ) v = value_type(d);
+          }
+          buf . in[j] . push_back( v );
+          if ( p < eol ) ++p; // skip the delimiter
+        }
+        ++n;
+      }
+      p = eol < end ? eol+1 : end;
+    }
+    buf . in_ptr . resize( n_in );
+    for ( size_t j = 0; j < n_in; ++j )
+      buf . in_ptr[j] = n > 0 ? &buf . in[j] . front() : 0;
+    return n;
+  }
+
+  template <typename T_type>
+  void
+  Columns<T_type>::format( value_type v, string & s ) const {
+    char str[64];
+    sprintf( str, "%.*g", digits, double(v) );
+    s += str;
+  }
+
+  template <typename T_type>
+  void
+  Columns<T_type>::csv_format( size_t n, Buffer const & buf, string & s ) const {
+    size_t n_in = keep ? buf . in . size() : 0;
+    for ( size_t i = 0; i < n; ++i ) {
+      for ( size_t j = 0; j < n_in; ++j ) {
+        if ( j > 0 ) s += delim;
+        format( buf . in_ptr[j][i], s );
+      }
+      for ( size_t k = 0; k < buf . out . size(); ++k ) {
+        if ( k > 0 || n_in > 0 ) s += delim;
+        format( buf . out[k][i], s );
+      }
+      s += '\n';
+    }
+  }
+
+  template <typename T_type>
+  size_t
+  Columns<T_type>::csv_chunk(
+    char const * begin,
+    char const * end,
+    string &     s,
+    Buffer &     buf,
+    size_t &     n_err
+  ) const {
+    size_t n = csv_parse( begin, end, buf );
+    n_err += eval( n, buf . in_ptr . empty() ? 0 : &buf . in_ptr . front(), buf );
+    csv_format( n, buf, s );
+    return n;
+  }
+
+  // end class Columns
+
+} // end namespace
+
+namespace calc_load {
+  using calc_defs::Columns;
+}
+
+#endif
+
+// end of file: calc_columns.hh
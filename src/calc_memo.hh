@@ -0,0 +1,310 @@
+/*--------------------------------------------------------------------------*\
+ |                                                                          |
+ |  This program is free software; you can redistribute it and/or modify    |
+ |  it under the terms of the GNU General Public License as published by    |
+ |  the Free Software Foundation; either version 2, or (at your option)     |
+ |  any later version.                                                      |
+ |                                                                          |
+ |  This program is distributed in the hope that it will be useful,         |
+ |  but WITHOUT ANY WARRANTY; without even the implied warranty of          |
+ |  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           |
+ |  GNU General Public License for more details.                            |
+ |                                                                          |
+ |  You should have received a copy of the GNU General Public License       |
+ |  along with this program; if not, write to the Free Software             |
+ |  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.               |
+ |                                                                          |
+ |  Copyright (C) 1999                                                      |
+ |                                                                          |
+ |            ___    ____  ___  __  __        ___    ____  ___  __  __      |
+ |           /   \  /     /   \  \  /        /   \  /     /   \  \  /       |
+ |          /____/ /__   /____/   \/        /____/ /__   /____/   \/        |
+ |         /   \  /     /   \     /        /   \  /     /   \     /         |
+ |        /____/ /____ /    /    /        /____/ /____ /    /    /          |
+ |                                                                          |
+ |      Enrico Bertolazzi                                                   |
+ |      Dipartimento di Ingegneria Meccanica e Strutturale                  |
+ |      Universita` degli Studi di Trento                                   |
+ |      Via Mesiano 77, I-38050 Trento, Italy                               |
+ |                                                                          |
+\*--------------------------------------------------------------------------*/
+
+
+#ifndef CALC_MEMO_HH
+#define CALC_MEMO_HH
+
+#include "calc.hh"
+
+#include <vector>
+#include <stdint.h>
+
+namespace calc_defs {
+
+  using namespace ::std;
+
+  /*!
+   * Direct mapped cache of the values of a pure function, the key are
+   * the bits of the arguments (so `0` and `-0` are different keys and
+   * a `NaN` argument can be cached).  The capacity is rounded to a
+   * power of two; on collision the older value is replaced.
+   *
+   * Lookups and insertions can be done concurrently by many threads:
+   * each entry is protected by a sequence number (a seqlock), odd
+   * while a thread writes the entry, so that a reader detects and
+   * ignores an entry being modified.  A writer finding the entry
+   * locked does not wait and does not cache its value.  With compilers
+   * other than GCC and clang the cache is not protected.
+   */
+  template <typename T_type, int N_args>
+  class Memo_cache {
+
+  public:
+
+    typedef T_type value_type;
+
+  private:
+
+    // arguments and value stored as words, accessed atomically
+    enum { n_words = ((N_args+1)*sizeof(value_type)+7)/8 };
+
+    typedef struct {
+      uint64_t seq; // 0: empty, odd: being written
+      uint64_t words[n_words];
+    } Entry;
+
+    vector<Entry> table;
+    size_t        mask;
+    unsigned long n_hits, n_misses;
+
+    Memo_cache( Memo_cache const & );
+    Memo_cache const & operator = ( Memo_cache const & );
+
+    #if defined(__GNUC__)
+    static uint64_t load_acquire( uint64_t const * p ) { return __atomic_load_n( p, __ATOMIC_ACQUIRE ); }
+    static uint64_t load_relaxed( uint64_t const * p ) { return __atomic_load_n( p, __ATOMIC_RELAXED ); }
+    static void store_release( uint64_t * p, uint64_t v ) { __atomic_store_n( p, v, __ATOMIC_RELEASE ); }
+    static bool
+    lock( uint64_t * p, uint64_t s )
+    { return __atomic_compare_exchange_n( p, &s, s+1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ); }
+    static void count( unsigned long * c ) { __atomic_fetch_add( c, 1, __ATOMIC_RELAXED ); }
+    #else
+    static uint64_t load_acquire( uint64_t const * p ) { return *p; }
+    static uint64_t load_relaxed( uint64_t const * p ) { return *p; }
+    static void store_release( uint64_t * p, uint64_t v ) { *p = v; }
+    static bool lock( uint64_t * p, uint64_t s ) { *p = s+1; return true; }
+    static void count( unsigned long * c ) { ++*c; }
+    #endif
+
+  public:
+
+    explicit
+    Memo_cache( size_t capacity )
+    : table(), mask(0), n_hits(0), n_misses(0)
+    { set_capacity(capacity); }
+
+    //! resize the cache (at least one entry), the content is lost
+    void
+    set_capacity( size_t capacity ) {
+      size_t n = 1;
+      while ( n < capacity ) n <<= 1;
+      table.assign( n, Entry() );
+      mask = n-1;
+      clear();
+    }
+
+    size_t capacity() const { return table.size(); }
+
+    //! remove all the cached values, not concurrently with `insert`
+    void
+    clear() {
+      for ( size_t i = 0; i < table.size(); ++i ) store_release( &table[i].seq, 0 );
+    }
+
+    unsigned long hits()   const { return n_hits; }
+    unsigned long misses() const { return n_misses; }
+
+    void reset_statistics() { n_hits = n_misses = 0; }
+
+    //! \return the entry for the arguments
+    size_t
+    slot( value_type const args[N_args] ) const {
+      // hash of the bits of the arguments
+      uint64_t h = 0;
+      for ( int k = 0; k < N_args; ++k ) {
+        unsigned char const * p = reinterpret_cast<unsigned char const *>(args+k);
+        for ( size_t i = 0; i < sizeof(value_type); i += sizeof(uint64_t) ) {
+          uint64_t w = 0;
+          size_t   l = sizeof(value_type)-i;
+          memcpy( &w, p+i, l < sizeof(uint64_t) ? l : sizeof(uint64_t) );
+          h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+        }
+      }
+      // final mix (MurmurHash3), the low bits of the key are often zero
+      h ^= h >> 33; h *= 0xFF51AFD7ED558CCDULL;
+      h ^= h >> 33; h *= 0xC4CEB9FE1A85EC53ULL;
+      h ^= h >> 33;
+      return size_t(h) & mask;
+    }
+
+    /*!
+     *  \return true if the entry `i` holds the value for the arguments,
+     *          copied in `v`
+     */
+    bool
+    find( size_t i, value_type const args[N_args], value_type & v ) {
+      Entry &  e  = table[i];
+      uint64_t s0 = load_acquire( &e.seq );
+      bool     ok = s0 != 0 && (s0 & 1) == 0;
+      uint64_t w[n_words];
+      if ( ok ) {
+        // acquire: the sequence number is read again after the words
+        for ( int k = 0; k < n_words; ++k ) w[k] = load_acquire( &e.words[k] );
+        ok = load_relaxed( &e.seq ) == s0 &&
+             memcmp( w, args, N_args*sizeof(value_type) ) == 0;
+      }
+      if ( ok ) {
+        memcpy( &v, reinterpret_cast<unsigned char const *>(w)+N_args*sizeof(value_type),
+                sizeof(value_type) );
+        count( &n_hits );
+      } else {
+        count( &n_misses );
+      }
+      return ok;
+    }
+
+    //! store the value for the arguments in the entry `i`
+    void
+    insert( size_t i, value_type const args[N_args], value_type v ) {
+      Entry &  e = table[i];
+      uint64_t s = load_relaxed( &e.seq );
+      // the lock (acquire) orders the writes of the words after it
+      if ( (s & 1) != 0 || !lock( &e.seq, s ) ) return; // being written
+      uint64_t w[n_words];
+      w[n_words-1] = 0;
+      memcpy( w, args, N_args*sizeof(value_type) );
+      memcpy( reinterpret_cast<unsigned char *>(w)+N_args*sizeof(value_type),
+              &v, sizeof(value_type) );
+      for ( int k = 0; k < n_words; ++k ) store_release( &e.words[k], w[k] );
+      store_release( &e.seq, s+2 );
+    }
+
+  };
+
+  /*!
+   * Memoization of a pure (no side effects, same result for the same
+   * argument) unary function: a call with an argument already seen
+   * costs a hash probe.  Register it in place of the function with
+   * `Calculator::set_unary_fun`.  The object can be used by many
+   * threads at once (e.g. the workers of a Sweep), see Memo_cache.
+   */
+  template <typename T_type = double>
+  class Memoized1 : public Unary_function<T_type> {
+
+  public:
+
+    typedef T_type                 value_type;
+    typedef value_type*            pointer;
+    typedef const value_type*      const_pointer;
+    typedef value_type (*Func1)(value_type);
+
+  private:
+
+    Func1                   fun;
+    Memo_cache<T_type,1>    cache;
+
+  public:
+
+    /*!
+     *  \param f        the function
+     *  \param capacity maximum number of cached values
+     */
+    explicit
+    Memoized1( Func1 f, size_t capacity = 1024 )
+    : fun(f), cache(capacity)
+    {}
+
+    void   set_capacity( size_t n ) { cache.set_capacity(n); }
+    size_t capacity() const { return cache.capacity(); }
+
+    //! invalidate the cached values, e.g. when the function changes
+    void clear() { cache.clear(); }
+
+    unsigned long hits()   const { return cache.hits(); }
+    unsigned long misses() const { return cache.misses(); }
+    void reset_statistics() { cache.reset_statistics(); }
+
+    value_type
+    eval( value_type x ) {
+      size_t     i = cache.slot( &x );
+      value_type v;
+      if ( !cache.find( i, &x, v ) ) cache.insert( i, &x, v = fun(x) );
+      return v;
+    }
+
+    void
+    eval( int n, const_pointer x, pointer y )
+    { for ( int i = 0; i < n; ++i ) y[i] = Memoized1::eval(x[i]); }
+
+  };
+
+  /*!
+   * Memoization of a pure binary function, see Memoized1
+   */
+  template <typename T_type = double>
+  class Memoized2 : public Binary_function<T_type> {
+
+  public:
+
+    typedef T_type                 value_type;
+    typedef value_type*            pointer;
+    typedef const value_type*      const_pointer;
+    typedef value_type (*Func2)(value_type,value_type);
+
+  private:
+
+    Func2                   fun;
+    Memo_cache<T_type,2>    cache;
+
+  public:
+
+    explicit
+    Memoized2( Func2 f, size_t capacity = 1024 )
+    : fun(f), cache(capacity)
+    {}
+
+    void   set_capacity( size_t n ) { cache.set_capacity(n); }
+    size_t capacity() const { return cache.capacity(); }
+
+    void clear() { cache.clear(); }
+
+    unsigned long hits()   const { return cache.hits(); }
+    unsigned long misses() const { return cache.misses(); }
+    void reset_statistics() { cache.reset_statistics(); }
+
+    value_type
+    eval( value_type x, value_type y ) {
+      value_type const args[2] = { x, y };
+      size_t     i = cache.slot( args );
+      value_type v;
+      if ( !cache.find( i, args, v ) ) cache.insert( i, args, v = fun(x,y) );
+      return v;
+    }
+
+    void
+    eval( int n, const_pointer x, const_pointer y, pointer z )
+    { for ( int i = 0; i < n; ++i ) z[i] = Memoized2::eval(x[i],y[i]); }
+
+  };
+
+  // end class Memoized1, Memoized2
+
+} // end namespace
+
+namespace calc_load {
+  using calc_defs::Memoized1;
+  using calc_defs::Memoized2;
+}
+
+#endif
+
+// end of file: calc_memo.hh
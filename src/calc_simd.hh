@@ -0,0 +1,473 @@
+/*--------------------------------------------------------------------------*\
+ |                                                                          |
+ |  This program is free software; you can redistribute it and/or modify    |
+ |  it under the terms of the GNU General Public License as published by    |
+ |  the Free Software Foundation; either version 2, or (at your option)     |
+ |  any later version.                                                      |
+ |                                                                          |
+ |  This program is distributed in the hope that it will be useful,         |
+ |  but WITHOUT ANY WARRANTY; without even the implied warranty of          |
+ |  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           |
+ |  GNU General Public License for more details.                            |
+ |                                                                          |
+ |  You should have received a copy of the GNU General Public License       |
+ |  along with this program; if not, write to the Free Software             |
+ |  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.               |
+ |                                                                          |
+ |  Copyright (C) 1999                                                      |
+ |                                                                          |
+ |            ___    ____  ___  __  __        ___    ____  ___  __  __      |
+ |           /   \  /     /   \  \  /        /   \  /     /   \  \  /       |
+ |          /____/ /__   /____/   \/        /____/ /__   /____/   \/        |
+ |         /   \  /     /   \     /        /   \  /     /   \     /         |
+ |        /____/ /____ /    /    /        /____/ /____ /    /    /          |
+ |                                                                          |
+ |      Enrico Bertolazzi                                                   |
+ |      Dipartimento di Ingegneria Meccanica e Strutturale                  |
+ |      Universita` degli Studi di Trento                                   |
+ |      Via Mesiano 77, I-38050 Trento, Italy                               |
+ |                                                                          |
+\*--------------------------------------------------------------------------*/
+
+
+#ifndef CALC_SIMD_HH
+#define CALC_SIMD_HH
+
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+/*!
+ * Vectorized versions of the builtin functions operating on arrays
+ * of `double`.  On x86-64 with GCC or Clang two code paths are
+ * compiled, SSE2 (2 lanes) and AVX2 (4 lanes), selected at run time;
+ * elsewhere, or defining `CALC_NO_SIMD`, the scalar libm functions
+ * are used.  No fused multiply-add is used, so the two paths give
+ * bitwise identical results.
+ *
+ * Maximum difference from the glibc libm results, in units in the
+ * last place (ULP), measured by `tests/simd_test.cc`:
+ *
+ *   abs, pos, neg, min, max, floor, ceil, sqrt  exact
+ *   exp                                         1 ULP
+ *   log                                         1 ULP
+ *   log10                                       2 ULP
+ *   sin, cos                                    2 ULP
+ *   tan                                         4 ULP
+ *   asin, acos, atan, atan2                     1 ULP
+ *   sinh, cosh, tanh                            2 ULP
+ *   pow                                         1 ULP
+ *
+ * The polynomial approximations are the ones of fdlibm; `sinh`,
+ * `cosh` and `tanh` use `exp` and, for |x| < 1, Taylor series.
+ * Arguments outside the ranges covered by the vector code are
+ * computed with libm: `exp`, `sinh` and `cosh` for |x| > 708, `log`
+ * for non positive, subnormal, infinite or NaN values, `sin`, `cos`
+ * and `tan` for |x| > 2^19, `asin` and `acos` for |x| >= 1, `atan2`
+ * for zero or infinite arguments or |y/x| outside (2^-59,2^60), `pow`
+ * unless x is positive and normal, |y| < 2^31 and |y*log2(x)| < 1020.
+ * Program computes `x^n` by multiplications for constant integers
+ * |n| <= 8 and `x^0.5` with `sqrt`.
+ */
+namespace calc_defs {
+  namespace simd {
+
+    typedef void (*Kernel1)( int n, double const * x, double * y );
+    typedef void (*Kernel2)( int n, double const * x, double const * y, double * z );
+
+    //! instruction set used by the kernels
+    typedef enum { Scalar = 0, SSE2 = 1, AVX2 = 2 } Level;
+
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(CALC_NO_SIMD)
+    #define CALC_SIMD_X86
+#endif
+
+    // scalar loops, used as fallback
+
+    template <double (*F)(double)>
+    void
+    loop1( int n, double const * x, double * y )
+    { for ( int i = 0; i < n; ++i ) y[i] = F(x[i]); }
+
+    template <double (*F)(double,double)>
+    void
+    loop2( int n, double const * x, double const * y, double * z )
+    { for ( int i = 0; i < n; ++i ) z[i] = F(x[i],y[i]); }
+
+    inline double s_abs( double x ) { return x > 0 ? x : -x; }
+    inline double s_pos( double x ) { return x > 0 ? x : 0; }
+    inline double s_neg( double x ) { return x > 0 ? 0 : x; }
+    inline double s_max( double a, double b ) { return a > b ? a : b; }
+    inline double s_min( double a, double b ) { return a < b ? a : b; }
+
+    inline double s_exp   ( double x ) { return std::exp(x);   }
+    inline double s_log   ( double x ) { return std::log(x);   }
+    inline double s_log10 ( double x ) { return std::log10(x); }
+    inline double s_sqrt  ( double x ) { return std::sqrt(x);  }
+    inline double s_sin   ( double x ) { return std::sin(x);   }
+    inline double s_cos   ( double x ) { return std::cos(x);   }
+    inline double s_tan   ( double x ) { return std::tan(x);   }
+    inline double s_floor ( double x ) { return std::floor(x); }
+    inline double s_ceil  ( double x ) { return std::ceil(x);  }
+    inline double s_asin  ( double x ) { return std::asin(x);  }
+    inline double s_acos  ( double x ) { return std::acos(x);  }
+    inline double s_atan  ( double x ) { return std::atan(x);  }
+    inline double s_sinh  ( double x ) { return std::sinh(x);  }
+    inline double s_cosh  ( double x ) { return std::cosh(x);  }
+    inline double s_tanh  ( double x ) { return std::tanh(x);  }
+    inline double s_atan2 ( double y, double x ) { return std::atan2(y,x); }
+    inline double s_pow   ( double x, double y ) { return std::pow(x,y);   }
+
+#ifdef CALC_SIMD_X86
+
+    #define CALC_SIMD_INLINE inline __attribute__((always_inline))
+
+    typedef double  v2d __attribute__((vector_size(16)));
+    typedef int64_t v2l __attribute__((vector_size(16)));
+    typedef double  v4d __attribute__((vector_size(32)));
+    typedef int64_t v4l __attribute__((vector_size(32)));
+
+    /*
+     * The kernels are written once in `calc_simd_vec.hh` for a vector
+     * type VD with integer companion VL (same lanes), and compiled twice:
+     * as Vec2 for SSE2 and as Vec4 under the AVX2 target, so that no
+     * function handling 32 bytes vectors is compiled without AVX (GCC
+     * would warn that this changes the ABI).  The loops calling them are
+     * macros expanded inside the functions compiled for each target.
+     */
+    #define CALC_SIMD_VEC Vec2
+    #define CALC_SIMD_VD  v2d
+    #define CALC_SIMD_VL  v2l
+    #define CALC_SIMD_SQRT __builtin_ia32_sqrtpd
+    #include "calc_simd_vec.hh"
+    #undef CALC_SIMD_VEC
+    #undef CALC_SIMD_VD
+    #undef CALC_SIMD_VL
+    #undef CALC_SIMD_SQRT
+
+    #if !defined(__clang__)
+      #pragma GCC push_options
+      #pragma GCC target("avx2")
+    #endif
+    #define CALC_SIMD_VEC Vec4
+    #define CALC_SIMD_VD  v4d
+    #define CALC_SIMD_VL  v4l
+    #define CALC_SIMD_SQRT __builtin_ia32_sqrtpd256
+    #include "calc_simd_vec.hh"
+    #undef CALC_SIMD_VEC
+    #undef CALC_SIMD_VD
+    #undef CALC_SIMD_VL
+    #undef CALC_SIMD_SQRT
+    #if !defined(__clang__)
+      #pragma GCC pop_options
+    #endif
+
+    /*
+     * Apply the vector function to the array, lanes flagged as special
+     * and the tail elements are computed with the scalar function.
+     * The special lanes are recomputed from the loaded vector because
+     * `y` may be `x` (Program evaluates in place).
+     */
+    #define CALC_SIMD_APPLY1( VEC, FUN, SCALAR )                         \
+      {                                                                  \
+        typedef VEC    V;                                                \
+        typedef V::VD  VD;                                               \
+        typedef V::VL  VL;                                               \
+        int i = 0;                                                       \
+        for ( ; i + V::W <= n; i += V::W ) {                             \
+          VL special;                                                    \
+          VD xv = V::load( x+i );                                        \
+          VD yv = V::FUN( xv, special );                                 \
+          V::store( y+i, yv );                                           \
+          if ( V::any(special) )                                         \
+            for ( int j = 0; j < V::W; ++j )                             \
+              if ( special[j] ) y[i+j] = SCALAR( xv[j] );                \
+        }                                                                \
+        for ( ; i < n; ++i ) y[i] = SCALAR( x[i] );                      \
+      }
+
+    #define CALC_SIMD_DEFINE1( NAME, FUN, SCALAR )                         \
+      inline void                                                          \
+      NAME##_sse2( int n, double const * x, double * y )                   \
+      CALC_SIMD_APPLY1( Vec2, FUN, SCALAR )                                \
+      __attribute__((target("avx2"))) inline void                          \
+      NAME##_avx2( int n, double const * x, double * y )                   \
+      CALC_SIMD_APPLY1( Vec4, FUN, SCALAR )
+
+    CALC_SIMD_DEFINE1( exp_n,   exp, std::exp )
+    CALC_SIMD_DEFINE1( log_n,   log, std::log )
+    CALC_SIMD_DEFINE1( sin_n,   sin, std::sin )
+    CALC_SIMD_DEFINE1( cos_n,   cos, std::cos )
+    CALC_SIMD_DEFINE1( tan_n,   tan, std::tan )
+    CALC_SIMD_DEFINE1( log10_n, log10, std::log10 )
+    CALC_SIMD_DEFINE1( asin_n,  asin, std::asin )
+    CALC_SIMD_DEFINE1( acos_n,  acos, std::acos )
+    CALC_SIMD_DEFINE1( atan_n,  atan, std::atan )
+    CALC_SIMD_DEFINE1( sinh_n,  sinh, std::sinh )
+    CALC_SIMD_DEFINE1( cosh_n,  cosh, std::cosh )
+    CALC_SIMD_DEFINE1( tanh_n,  tanh, std::tanh )
+
+    #undef CALC_SIMD_DEFINE1
+    #undef CALC_SIMD_APPLY1
+
+    // as CALC_SIMD_APPLY1 for the functions of two arguments
+    #define CALC_SIMD_APPLY2( VEC, FUN, SCALAR )                         \
+      {                                                                  \
+        typedef VEC    V;                                                \
+        typedef V::VD  VD;                                               \
+        typedef V::VL  VL;                                               \
+        int i = 0;                                                       \
+        for ( ; i + V::W <= n; i += V::W ) {                             \
+          VL special;                                                    \
+          VD xv = V::load( x+i ), yv = V::load( y+i );                   \
+          VD zv = V::FUN( xv, yv, special );                             \
+          V::store( z+i, zv );                                           \
+          if ( V::any(special) )                                         \
+            for ( int j = 0; j < V::W; ++j )                             \
+              if ( special[j] ) z[i+j] = SCALAR( xv[j], yv[j] );         \
+        }                                                                \
+        for ( ; i < n; ++i ) z[i] = SCALAR( x[i], y[i] );                \
+      }
+
+    #define CALC_SIMD_DEFINE2( NAME, FUN, SCALAR )                         \
+      inline void                                                          \
+      NAME##_sse2( int n, double const * x, double const * y, double * z ) \
+      CALC_SIMD_APPLY2( Vec2, FUN, SCALAR )                                \
+      __attribute__((target("avx2"))) inline void                          \
+      NAME##_avx2( int n, double const * x, double const * y, double * z ) \
+      CALC_SIMD_APPLY2( Vec4, FUN, SCALAR )
+
+    CALC_SIMD_DEFINE2( atan2_n, atan2, std::atan2 )
+    CALC_SIMD_DEFINE2( pow_n,   pow,   std::pow )
+
+    #undef CALC_SIMD_DEFINE2
+    #undef CALC_SIMD_APPLY2
+
+    // elementwise functions without special cases, `xv` is the loaded
+    // vector, `a` and `b` the two loaded vectors
+
+    #define CALC_SIMD_MAP1( VEC, VEXPR, SCALAR )                          \
+      {                                                                  \
+        typedef VEC    V;                                                \
+        typedef V::VD  VD;                                               \
+        int i = 0;                                                       \
+        for ( ; i + V::W <= n; i += V::W ) {                             \
+          VD xv = V::load( x+i );                                        \
+          V::store( y+i, VEXPR );                                        \
+        }                                                                \
+        for ( ; i < n; ++i ) y[i] = SCALAR( x[i] );                      \
+      }
+
+    #define CALC_SIMD_MAP2( VEC, VEXPR, SCALAR )                          \
+      {                                                                  \
+        typedef VEC    V;                                                \
+        typedef V::VD  VD;                                               \
+        int i = 0;                                                       \
+        for ( ; i + V::W <= n; i += V::W ) {                             \
+          VD a = V::load( x+i ), b = V::load( y+i );                     \
+          V::store( z+i, VEXPR );                                        \
+        }                                                                \
+        for ( ; i < n; ++i ) z[i] = SCALAR( x[i], y[i] );                \
+      }
+
+    inline void abs_n_sse2( int n, double const * x, double * y )
+    CALC_SIMD_MAP1( Vec2, V::fabs( xv ), s_abs )
+    inline void pos_n_sse2( int n, double const * x, double * y )
+    CALC_SIMD_MAP1( Vec2, V::select( xv > V::splat(0.0), xv, V::splat(0.0) ), s_pos )
+    inline void neg_n_sse2( int n, double const * x, double * y )
+    CALC_SIMD_MAP1( Vec2, V::select( xv > V::splat(0.0), V::splat(0.0), xv ), s_neg )
+    inline void max_n_sse2( int n, double const * x, double const * y, double * z )
+    CALC_SIMD_MAP2( Vec2, V::select( a > b, a, b ), s_max )
+    inline void min_n_sse2( int n, double const * x, double const * y, double * z )
+    CALC_SIMD_MAP2( Vec2, V::select( a < b, a, b ), s_min )
+
+    __attribute__((target("avx2"))) inline void abs_n_avx2( int n, double const * x, double * y )
+    CALC_SIMD_MAP1( Vec4, V::fabs( xv ), s_abs )
+    __attribute__((target("avx2"))) inline void pos_n_avx2( int n, double const * x, double * y )
+    CALC_SIMD_MAP1( Vec4, V::select( xv > V::splat(0.0), xv, V::splat(0.0) ), s_pos )
+    __attribute__((target("avx2"))) inline void neg_n_avx2( int n, double const * x, double * y )
+    CALC_SIMD_MAP1( Vec4, V::select( xv > V::splat(0.0), V::splat(0.0), xv ), s_neg )
+    __attribute__((target("avx2"))) inline void max_n_avx2( int n, double const * x, double const * y, double * z )
+    CALC_SIMD_MAP2( Vec4, V::select( a > b, a, b ), s_max )
+    __attribute__((target("avx2"))) inline void min_n_avx2( int n, double const * x, double const * y, double * z )
+    CALC_SIMD_MAP2( Vec4, V::select( a < b, a, b ), s_min )
+
+    #undef CALC_SIMD_MAP1
+    #undef CALC_SIMD_MAP2
+
+    // hardware square root and rounding
+
+    inline void
+    sqrt_n_sse2( int n, double const * x, double * y ) {
+      int i = 0;
+      for ( ; i + 2 <= n; i += 2 ) {
+        v2d v; memcpy( &v, x+i, sizeof(v) );
+        v = __builtin_ia32_sqrtpd( v );
+        memcpy( y+i, &v, sizeof(v) );
+      }
+      for ( ; i < n; ++i ) y[i] = std::sqrt( x[i] );
+    }
+
+    __attribute__((target("avx2"))) inline void
+    sqrt_n_avx2( int n, double const * x, double * y ) {
+      int i = 0;
+      for ( ; i + 4 <= n; i += 4 ) {
+        v4d v; memcpy( &v, x+i, sizeof(v) );
+        v = __builtin_ia32_sqrtpd256( v );
+        memcpy( y+i, &v, sizeof(v) );
+      }
+      for ( ; i < n; ++i ) y[i] = std::sqrt( x[i] );
+    }
+
+    // SSE2 has no rounding instruction, floor and ceil use libm there
+    __attribute__((target("avx2"))) inline void
+    floor_n_avx2( int n, double const * x, double * y ) {
+      int i = 0;
+      for ( ; i + 4 <= n; i += 4 ) {
+        v4d v; memcpy( &v, x+i, sizeof(v) );
+        v = __builtin_ia32_roundpd256( v, 0x09 ); // floor, no exceptions
+        memcpy( y+i, &v, sizeof(v) );
+      }
+      for ( ; i < n; ++i ) y[i] = std::floor( x[i] );
+    }
+
+    __attribute__((target("avx2"))) inline void
+    ceil_n_avx2( int n, double const * x, double * y ) {
+      int i = 0;
+      for ( ; i + 4 <= n; i += 4 ) {
+        v4d v; memcpy( &v, x+i, sizeof(v) );
+        v = __builtin_ia32_roundpd256( v, 0x0A ); // ceil, no exceptions
+        memcpy( y+i, &v, sizeof(v) );
+      }
+      for ( ; i < n; ++i ) y[i] = std::ceil( x[i] );
+    }
+
+    #undef CALC_SIMD_INLINE
+
+#endif
+
+    inline
+    Level &
+    level_ref() {
+#ifdef CALC_SIMD_X86
+      static Level lv = __builtin_cpu_supports("avx2") ? AVX2 : SSE2;
+#else
+      static Level lv = Scalar;
+#endif
+      return lv;
+    }
+
+    //! \return the instruction set used by the kernels
+    inline Level level() { return level_ref(); }
+
+    /*!
+     *  Select the instruction set, for testing.  A level not
+     *  supported by the processor is lowered to the best available.
+     */
+    inline
+    void
+    set_level( Level lv ) {
+#ifdef CALC_SIMD_X86
+      if ( lv == AVX2 && !__builtin_cpu_supports("avx2") ) lv = SSE2;
+#else
+      lv = Scalar;
+#endif
+      level_ref() = lv;
+    }
+
+#ifdef CALC_SIMD_X86
+    #define CALC_SIMD_DISPATCH1( NAME, SSE2_FUN, AVX2_FUN, SCALAR )     \
+      inline void                                                        \
+      NAME( int n, double const * x, double * y ) {                      \
+        switch ( level() ) {                                             \
+        case AVX2: AVX2_FUN( n, x, y ); break;                           \
+        case SSE2: SSE2_FUN( n, x, y ); break;                           \
+        default:   loop1<SCALAR>( n, x, y ); break;                      \
+        }                                                                \
+      }
+    #define CALC_SIMD_DISPATCH2( NAME, SSE2_FUN, AVX2_FUN, SCALAR )     \
+      inline void                                                        \
+      NAME( int n, double const * x, double const * y, double * z ) {    \
+        switch ( level() ) {                                             \
+        case AVX2: AVX2_FUN( n, x, y, z ); break;                        \
+        case SSE2: SSE2_FUN( n, x, y, z ); break;                        \
+        default:   loop2<SCALAR>( n, x, y, z ); break;                   \
+        }                                                                \
+      }
+#else
+    #define CALC_SIMD_DISPATCH1( NAME, SSE2_FUN, AVX2_FUN, SCALAR )     \
+      inline void                                                        \
+      NAME( int n, double const * x, double * y )                        \
+      { loop1<SCALAR>( n, x, y ); }
+    #define CALC_SIMD_DISPATCH2( NAME, SSE2_FUN, AVX2_FUN, SCALAR )     \
+      inline void                                                        \
+      NAME( int n, double const * x, double const * y, double * z )      \
+      { loop2<SCALAR>( n, x, y, z ); }
+#endif
+
+    CALC_SIMD_DISPATCH1( vabs,   abs_n_sse2,       abs_n_avx2,   s_abs   )
+    CALC_SIMD_DISPATCH1( vpos,   pos_n_sse2,       pos_n_avx2,   s_pos   )
+    CALC_SIMD_DISPATCH1( vneg,   neg_n_sse2,       neg_n_avx2,   s_neg   )
+    CALC_SIMD_DISPATCH1( vsqrt,  sqrt_n_sse2,      sqrt_n_avx2,  s_sqrt  )
+    CALC_SIMD_DISPATCH1( vfloor, loop1<s_floor>,   floor_n_avx2, s_floor )
+    CALC_SIMD_DISPATCH1( vceil,  loop1<s_ceil>,    ceil_n_avx2,  s_ceil  )
+    CALC_SIMD_DISPATCH1( vexp,   exp_n_sse2,       exp_n_avx2,   s_exp   )
+    CALC_SIMD_DISPATCH1( vlog,   log_n_sse2,       log_n_avx2,   s_log   )
+    CALC_SIMD_DISPATCH1( vlog10, log10_n_sse2,     log10_n_avx2, s_log10 )
+    CALC_SIMD_DISPATCH1( vsin,   sin_n_sse2,       sin_n_avx2,   s_sin   )
+    CALC_SIMD_DISPATCH1( vcos,   cos_n_sse2,       cos_n_avx2,   s_cos   )
+    CALC_SIMD_DISPATCH1( vtan,   tan_n_sse2,       tan_n_avx2,   s_tan   )
+    CALC_SIMD_DISPATCH1( vasin,  asin_n_sse2,      asin_n_avx2,  s_asin  )
+    CALC_SIMD_DISPATCH1( vacos,  acos_n_sse2,      acos_n_avx2,  s_acos  )
+    CALC_SIMD_DISPATCH1( vatan,  atan_n_sse2,      atan_n_avx2,  s_atan  )
+    CALC_SIMD_DISPATCH1( vsinh,  sinh_n_sse2,      sinh_n_avx2,  s_sinh  )
+    CALC_SIMD_DISPATCH1( vcosh,  cosh_n_sse2,      cosh_n_avx2,  s_cosh  )
+    CALC_SIMD_DISPATCH1( vtanh,  tanh_n_sse2,      tanh_n_avx2,  s_tanh  )
+    CALC_SIMD_DISPATCH2( vmax,   max_n_sse2,       max_n_avx2,   s_max   )
+    CALC_SIMD_DISPATCH2( vmin,   min_n_sse2,       min_n_avx2,   s_min   )
+    CALC_SIMD_DISPATCH2( vatan2, atan2_n_sse2,     atan2_n_avx2, s_atan2 )
+    CALC_SIMD_DISPATCH2( vpow,   pow_n_sse2,       pow_n_avx2,   s_pow   )
+
+    #undef CALC_SIMD_DISPATCH1
+    #undef CALC_SIMD_DISPATCH2
+
+    /*!
+     *  \return the vector version of the builtin unary function
+     *          `name`, 0 if not available
+     */
+    inline
+    Kernel1
+    unary( char const * name ) {
+      static struct { char const * name; Kernel1 fun; } const tab[] = {
+        { "abs",   vabs   }, { "acos",  vacos  }, { "asin",  vasin  },
+        { "atan",  vatan  }, { "ceil",  vceil  }, { "cos",   vcos   },
+        { "cosh",  vcosh  }, { "exp",   vexp   }, { "floor", vfloor },
+        { "log",   vlog   }, { "log10", vlog10 }, { "neg",   vneg   },
+        { "pos",   vpos   }, { "sin",   vsin   }, { "sinh",  vsinh  },
+        { "sqrt",  vsqrt  }, { "tan",   vtan   }, { "tanh",  vtanh  }
+      };
+      for ( unsigned i = 0; i < sizeof(tab)/sizeof(tab[0]); ++i )
+        if ( strcmp( name, tab[i].name ) == 0 ) return tab[i].fun;
+      return 0;
+    }
+
+    /*!
+     *  \return the vector version of the builtin binary function
+     *          `name`, 0 if not available
+     */
+    inline
+    Kernel2
+    binary( char const * name ) {
+      if ( strcmp( name, "max" )   == 0 ) return vmax;
+      if ( strcmp( name, "min" )   == 0 ) return vmin;
+      if ( strcmp( name, "atan2" ) == 0 ) return vatan2;
+      if ( strcmp( name, "pow" )   == 0 ) return vpow;
+      return 0;
+    }
+
+  } // end namespace simd
+} // end namespace
+
+#endif
+
+// end of file: calc_simd.hh
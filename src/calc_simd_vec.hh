@@ -0,0 +1,504 @@
+/*--------------------------------------------------------------------------*\
+ |                                                                          |
+ |  This program is free software; you can redistribute it and/or modify    |
+ |  it under the terms of the GNU General Public License as published by    |
+ |  the Free Software Foundation; either version 2, or (at your option)     |
+ |  any later version.                                                      |
+ |                                                                          |
+ |  This program is distributed in the hope that it will be useful,         |
+ |  but WITHOUT ANY WARRANTY; without even the implied warranty of          |
+ |  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           |
+ |  GNU General Public License for more details.                            |
+ |                                                                          |
+ |  You should have received a copy of the GNU General Public License       |
+ |  along with this program; if not, write to the Free Software             |
+ |  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.               |
+ |                                                                          |
+ |  Copyright (C) 1999                                                      |
+ |                                                                          |
+ |            ___    ____  ___  __  __        ___    ____  ___  __  __      |
+ |           /   \  /     /   \  \  /        /   \  /     /   \  \  /       |
+ |          /____/ /__   /____/   \/        /____/ /__   /____/   \/        |
+ |         /   \  /     /   \     /        /   \  /     /   \     /         |
+ |        /____/ /____ /    /    /        /____/ /____ /    /    /          |
+ |                                                                          |
+ |      Enrico Bertolazzi                                                   |
+ |      Dipartimento di Ingegneria Meccanica e Strutturale                  |
+ |      Universita` degli Studi di Trento                                   |
+ |      Via Mesiano 77, I-38050 Trento, Italy                               |
+ |                                                                          |
+\*--------------------------------------------------------------------------*/
+
+/*
+ * Vector kernels of calc_simd.hh, included by it once per vector type
+ * with CALC_SIMD_VEC (name of the class), CALC_SIMD_VD (double vector),
+ * CALC_SIMD_VL (int64_t vector with the same lanes) and CALC_SIMD_SQRT
+ * (square root builtin of the vector type) defined.  No include guard
+ * on purpose.  Vector casts reinterpret the bits,
+ * comparisons give all ones/all zeros integer lanes.
+ */
+
+    struct CALC_SIMD_VEC {
+      typedef CALC_SIMD_VD VD;
+      typedef CALC_SIMD_VL VL;
+
+      enum { W = sizeof(VD)/sizeof(double) };
+
+      static CALC_SIMD_INLINE VD splat( double a )
+      { VD v; for ( int i = 0; i < W; ++i ) v[i] = a; return v; }
+
+      static CALC_SIMD_INLINE VL splat( int64_t a )
+      { VL v; for ( int i = 0; i < W; ++i ) v[i] = a; return v; }
+
+      static CALC_SIMD_INLINE VD load( double const * p )
+      { VD v; memcpy( &v, p, sizeof(VD) ); return v; }
+
+      static CALC_SIMD_INLINE void store( double * p, VD const & v )
+      { memcpy( p, &v, sizeof(VD) ); }
+
+      // mask ? a : b
+      static CALC_SIMD_INLINE VD select( VL const & mask, VD const & a, VD const & b )
+      { return (VD)( ((VL)a & mask) | ((VL)b & ~mask) ); }
+
+      static CALC_SIMD_INLINE bool any( VL const & mask )
+      { int64_t r = 0; for ( int i = 0; i < W; ++i ) r |= mask[i]; return r != 0; }
+
+      static CALC_SIMD_INLINE VD fabs( VD const & x )
+      { return (VD)( (VL)x & splat(int64_t(0x7FFFFFFFFFFFFFFFLL)) ); }
+
+      // round to nearest integer, |x| < 2^51
+      static CALC_SIMD_INLINE VD round( VD const & x, VL & k ) {
+        VD const magic = splat(6755399441055744.0); // 1.5*2^52
+        VD t = x + magic;
+        k = (VL)t - (VL)magic;
+        return t - magic;
+      }
+
+      // integer to double, |k| < 2^51
+      static CALC_SIMD_INLINE VD to_double( VL const & k ) {
+        VD const magic = splat(6755399441055744.0);
+        return (VD)( k + (VL)magic ) - magic;
+      }
+
+      static CALC_SIMD_INLINE VD
+      exp( VD const & x, VL & special ) {
+        special = ~( fabs(x) <= splat(708.0) ); // true also for NaN
+        VL k;
+        VD n = round( x * splat(1.44269504088896338700e+00), k );
+        VD r = x - n * splat(6.93147180369123816490e-01);
+        r = r - n * splat(1.90821492927058770002e-10);
+        // Taylor polynomial of degree 13 on [-ln2/2,ln2/2]
+        VD p = splat(1.0/6227020800.0);
+        p = p * r + splat(1.0/479001600.0);
+        p = p * r + splat(1.0/39916800.0);
+        p = p * r + splat(1.0/3628800.0);
+        p = p * r + splat(1.0/362880.0);
+        p = p * r + splat(1.0/40320.0);
+        p = p * r + splat(1.0/5040.0);
+        p = p * r + splat(1.0/720.0);
+        p = p * r + splat(1.0/120.0);
+        p = p * r + splat(1.0/24.0);
+        p = p * r + splat(1.0/6.0);
+        p = p * r + splat(0.5);
+        p = r + (r * r) * p;
+        p = p + splat(1.0);
+        // scale by 2^k, safe range ensures a normal result
+        VL e = (k + splat(int64_t(1023))) << 52;
+        return p * (VD)e;
+      }
+
+      static CALC_SIMD_INLINE VD
+      log( VD const & x, VL & special ) {
+        special = ~( x >= splat(2.2250738585072014e-308) &&
+                     x <= splat(1.7976931348623157e+308) );
+        VL ix = (VL)x;
+        VL k  = (ix >> 52) - splat(int64_t(1023));
+        VD m  = (VD)( (ix & splat(int64_t(0x000FFFFFFFFFFFFFLL))) |
+                      splat(int64_t(0x3FF0000000000000LL)) );
+        // normalize mantissa in [sqrt(2)/2,sqrt(2))
+        VL big = m > splat(1.41421356237309504880);
+        m = (VD)( (VL)m - (big & splat(int64_t(1)<<52)) );
+        k = k - big;
+
+        VD f    = m - splat(1.0);
+        VD hfsq = splat(0.5) * f * f;
+        VD s    = f / ( splat(2.0) + f );
+        VD z    = s * s;
+        VD w    = z * z;
+        VD t1 = w * ( splat(3.999999999940941908e-01) +
+                w * ( splat(2.222219843214978396e-01) +
+                w *   splat(1.531383769920937332e-01) ) );
+        VD t2 = z * ( splat(6.666666666666735130e-01) +
+                w * ( splat(2.857142874366239149e-01) +
+                w * ( splat(1.818357216161805012e-01) +
+                w *   splat(1.479819860511658591e-01) ) ) );
+        VD R  = t2 + t1;
+        VD dk = to_double(k);
+        return dk * splat(6.93147180369123816490e-01) -
+               ( ( hfsq - ( s * ( hfsq + R ) +
+                            dk * splat(1.90821492927058770002e-10) ) ) - f );
+      }
+
+      // reduce x to r in [-pi/4,pi/4], x = r + q*pi/2
+      static CALC_SIMD_INLINE VD
+      reduce( VD const & x, VL & q, VL & special ) {
+        special = ~( fabs(x) <= splat(524288.0) ); // 2^19
+        VD n = round( x * splat(6.36619772367581382433e-01), q );
+        VD r = x - n * splat(1.57079632673412561417e+00);
+        r = r - n * splat(6.07710050630396597660e-11);
+        return r - n * splat(2.02226624879595063154e-21);
+      }
+
+      static CALC_SIMD_INLINE VD
+      sin_kernel( VD const & r, VD const & z ) {
+        VD p = splat(8.33333333332248946124e-03) +
+          z * ( splat(-1.98412698298579493134e-04) +
+          z * ( splat(2.75573137070700676789e-06) +
+          z * ( splat(-2.50507602534068634195e-08) +
+          z *   splat(1.58969099521155010221e-10) ) ) );
+        return r + ( z * r ) * ( splat(-1.66666666666666324348e-01) + z * p );
+      }
+
+      static CALC_SIMD_INLINE VD
+      cos_kernel( VD const & z ) {
+        VD p = z * ( splat(4.16666666666666019037e-02) +
+          z * ( splat(-1.38888888888741095749e-03) +
+          z * ( splat(2.48015872894767294178e-05) +
+          z * ( splat(-2.75573143513906633035e-07) +
+          z * ( splat(2.08757232129817482790e-09) +
+          z *   splat(-1.13596475577881948265e-11) ) ) ) ) );
+        VD hz = splat(0.5) * z;
+        VD w  = splat(1.0) - hz;
+        return w + ( ( ( splat(1.0) - w ) - hz ) + z * p );
+      }
+
+      static CALC_SIMD_INLINE VD
+      negate_if( VL const & mask, VD const & v )
+      { return (VD)( (VL)v ^ ( mask & splat(int64_t(1)<<63) ) ); }
+
+      static CALC_SIMD_INLINE VD
+      sin( VD const & x, VL & special ) {
+        VL q;
+        VD r  = reduce( x, q, special );
+        VD z  = r * r;
+        VD s  = sin_kernel( r, z );
+        VD c  = cos_kernel( z );
+        VL one = splat(int64_t(1));
+        VD res = select( (q & one) == one, c, s );
+        res = negate_if( (q & splat(int64_t(2))) != splat(int64_t(0)), res );
+        // keep the sign of zero and tiny arguments
+        return select( fabs(x) < splat(7.450580596923828125e-9), x, res );
+      }
+
+      static CALC_SIMD_INLINE VD
+      cos( VD const & x, VL & special ) {
+        VL q;
+        VD r  = reduce( x, q, special );
+        VD z  = r * r;
+        VD s  = sin_kernel( r, z );
+        VD c  = cos_kernel( z );
+        VL one = splat(int64_t(1));
+        VD res = select( (q & one) == one, s, c );
+        return negate_if( ((q + one) & splat(int64_t(2))) != splat(int64_t(0)), res );
+      }
+
+      static CALC_SIMD_INLINE VD
+      tan( VD const & x, VL & special ) {
+        VL q;
+        VD r  = reduce( x, q, special );
+        VD z  = r * r;
+        VD s  = sin_kernel( r, z );
+        VD c  = cos_kernel( z );
+        VL one = splat(int64_t(1));
+        VD res = select( (q & one) == one, -c / s, s / c );
+        return select( fabs(x) < splat(7.450580596923828125e-9), x, res );
+      }
+
+      static CALC_SIMD_INLINE VD
+      log10( VD const & x, VL & special )
+      { return log( x, special ) * splat(4.34294481903251827651e-01); }
+
+      static CALC_SIMD_INLINE VD sqrt( VD const & x )
+      { return CALC_SIMD_SQRT( x ); }
+
+      // |v| with the sign of x
+      static CALC_SIMD_INLINE VD
+      copysign( VD const & v, VD const & x ) {
+        VL const sign = splat(int64_t(1)<<63);
+        return (VD)( ((VL)v & ~sign) | ((VL)x & sign) );
+      }
+
+      // v with the low 32 bits of the mantissa cleared
+      static CALC_SIMD_INLINE VD
+      clear_low( VD const & v )
+      { return (VD)( (VL)v & splat(int64_t(0xFFFFFFFF00000000ULL)) ); }
+
+      // atan of a >= 0, reduced to 4 intervals around 0.5, 1, 1.5, inf
+      static CALC_SIMD_INLINE VD
+      atan_pos( VD const & a ) {
+        VL r0 = a < splat(0.4375);
+        VL r1 = a < splat(0.6875);
+        VL r2 = a < splat(1.1875);
+        VL r3 = a < splat(2.4375);
+        VD one = splat(1.0);
+        VD num = select( r0, a, select( r1, splat(2.0)*a - one,
+                 select( r2, a - one, select( r3, a - splat(1.5), -one ) ) ) );
+        VD den = select( r0, one, select( r1, splat(2.0) + a,
+                 select( r2, a + one, select( r3, one + splat(1.5)*a, a ) ) ) );
+        VD hi  = select( r0, splat(0.0), select( r1, splat(4.63647609000806093515e-01),
+                 select( r2, splat(7.85398163397448278999e-01),
+                 select( r3, splat(9.82793723247329054082e-01),
+                             splat(1.57079632679489655800e+00) ) ) ) );
+        VD lo  = select( r0, splat(0.0), select( r1, splat(2.26987774529616870924e-17),
+                 select( r2, splat(3.06161699786838301793e-17),
+                 select( r3, splat(1.39033110312309984516e-17),
+                             splat(6.12323399573676603587e-17) ) ) ) );
+        VD t  = num / den;
+        VD z  = t * t;
+        VD w  = z * z;
+        VD s1 = z * ( splat(3.33333333333329318027e-01) +
+                w * ( splat(1.42857142725034663711e-01) +
+                w * ( splat(9.09088713343650656196e-02) +
+                w * ( splat(6.66107313738753120669e-02) +
+                w * ( splat(4.97687799461593236017e-02) +
+                w *   splat(1.62858201153657823623e-02) ) ) ) ) );
+        VD s2 = w * ( splat(-1.99999999998764832476e-01) +
+                w * ( splat(-1.11111104054623557880e-01) +
+                w * ( splat(-7.69187620504482999495e-02) +
+                w * ( splat(-5.83357013379057348645e-02) +
+                w *   splat(-3.65315727442169155270e-02) ) ) ) );
+        // for a < 0.4375 this is t - t*(s1+s2)
+        return hi - ( ( t * ( s1 + s2 ) - lo ) - t );
+      }
+
+      static CALC_SIMD_INLINE VD
+      atan( VD const & x, VL & special ) {
+        special = x != x;
+        return copysign( atan_pos( fabs(x) ), x );
+      }
+
+      // rational approximation of (asin(sqrt(t))-sqrt(t))/sqrt(t)^3
+      static CALC_SIMD_INLINE VD
+      asin_ratio( VD const & t ) {
+        VD p = t * ( splat(1.66666666666666657415e-01) +
+               t * ( splat(-3.25565818622400915405e-01) +
+               t * ( splat(2.01212532134862925881e-01) +
+               t * ( splat(-4.00555345006794114027e-02) +
+               t * ( splat(7.91534994289814532176e-04) +
+               t *   splat(3.47933107596021167570e-05) ) ) ) ) );
+        VD q = splat(1.0) +
+               t * ( splat(-2.40339491173441421878e+00) +
+               t * ( splat(2.02094576023350569471e+00) +
+               t * ( splat(-6.88283971605453293030e-01) +
+               t *   splat(7.70381505559019352791e-02) ) ) );
+        return p / q;
+      }
+
+      static CALC_SIMD_INLINE VD
+      asin( VD const & x, VL & special ) {
+        special = ~( fabs(x) < splat(1.0) ); // |x| >= 1 and NaN
+        VD const pio2_hi = splat(1.57079632679489655800e+00);
+        VD const pio2_lo = splat(6.12323399573676603587e-17);
+        VD const pio4_hi = splat(7.85398163397448278999e-01);
+        VD ax    = fabs(x);
+        VL small = ax < splat(0.5);
+        VD t     = select( small, x * x, ( splat(1.0) - ax ) * splat(0.5) );
+        VD r     = asin_ratio( t );
+        VD s     = sqrt( t );
+        // |x| >= 0.975 (high word 0x3FEF3333)
+        VL near1 = ( (VL)ax >> 32 ) >= splat(int64_t(0x3FEF3333));
+        VD res1  = pio2_hi - ( splat(2.0) * ( s + s * r ) - pio2_lo );
+        VD w     = clear_low( s );
+        VD c     = ( t - w * w ) / ( s + w );
+        VD p     = splat(2.0) * s * r - ( pio2_lo - splat(2.0) * c );
+        VD q     = pio4_hi - splat(2.0) * w;
+        VD res2  = pio4_hi - ( p - q );
+        VD res   = select( small, ax + ax * r, select( near1, res1, res2 ) );
+        return copysign( res, x );
+      }
+
+      static CALC_SIMD_INLINE VD
+      acos( VD const & x, VL & special ) {
+        special = ~( fabs(x) < splat(1.0) ); // |x| >= 1 and NaN
+        VD const pio2_hi = splat(1.57079632679489655800e+00);
+        VD const pio2_lo = splat(6.12323399573676603587e-17);
+        VD ax    = fabs(x);
+        VL small = ax < splat(0.5);
+        VD z     = select( small, x * x, ( splat(1.0) - ax ) * splat(0.5) );
+        VD r     = asin_ratio( z );
+        VD s     = sqrt( z );
+        VD res0  = pio2_hi - ( x - ( pio2_lo - x * r ) );
+        VD resn  = splat(3.14159265358979311600e+00) -
+                   splat(2.0) * ( s + ( r * s - pio2_lo ) );
+        VD df    = clear_low( s );
+        VD c     = ( z - df * df ) / ( s + df );
+        VD resp  = splat(2.0) * ( df + ( r * s + c ) );
+        return select( small, res0, select( x < splat(0.0), resn, resp ) );
+      }
+
+      // y and x finite, not zero, with |y/x| in (2^-59,2^60)
+      static CALC_SIMD_INLINE VD
+      atan2( VD const & y, VD const & x, VL & special ) {
+        VD ax = fabs(x), ay = fabs(y);
+        VD r  = ay / ax;
+        special = ~( ax > splat(0.0) && ax <= splat(1.7976931348623157e+308) &&
+                     ay > splat(0.0) && ay <= splat(1.7976931348623157e+308) &&
+                     r  > splat(1.7347234759768071e-18) &&  // 2^-59
+                     r  < splat(1.152921504606846976e+18) ); // 2^60
+        VD z  = atan_pos( r );
+        VD zx = select( x < splat(0.0),
+                        splat(3.14159265358979311600e+00) -
+                        ( z - splat(1.2246467991473531772e-16) ), z );
+        return copysign( zx, y );
+      }
+
+      // x*x*P(x*x) ~ sinh(x)-x for |x| < 1, Taylor series
+      static CALC_SIMD_INLINE VD
+      sinh_poly( VD const & z ) {
+        return splat(1.0/6.0) +
+          z * ( splat(1.0/120.0) +
+          z * ( splat(1.0/5040.0) +
+          z * ( splat(1.0/362880.0) +
+          z * ( splat(1.0/39916800.0) +
+          z * ( splat(1.0/6227020800.0) +
+          z * ( splat(1.0/1307674368000.0) +
+          z * ( splat(1.0/355687428096000.0) +
+          z *   splat(1.0/121645100408832000.0) ) ) ) ) ) ) );
+      }
+
+      static CALC_SIMD_INLINE VD
+      sinh( VD const & x, VL & special ) {
+        VD ax = fabs(x);
+        VD z  = x * x;
+        VD e  = exp( ax, special );
+        VD rs = ax + ( ax * z ) * sinh_poly( z );
+        VD rl = splat(0.5) * e - splat(0.5) / e;
+        return copysign( select( ax < splat(1.0), rs, rl ), x );
+      }
+
+      static CALC_SIMD_INLINE VD
+      cosh( VD const & x, VL & special ) {
+        VD e = exp( fabs(x), special );
+        return splat(0.5) * e + splat(0.5) / e;
+      }
+
+      static CALC_SIMD_INLINE VD
+      tanh( VD const & x, VL & special ) {
+        special = x != x;
+        VD ax = fabs(x);
+        VD z  = x * x;
+        // |x| < 1: sinh/cosh = x + x*z*(D(z)/(1+z*C(z))), with the
+        // Taylor series sinh = x+x*z*S(z), cosh = 1+z*C(z), D = S-C
+        VD cm = z * ( splat(0.5) +
+          z * ( splat(1.0/24.0) +
+          z * ( splat(1.0/720.0) +
+          z * ( splat(1.0/40320.0) +
+          z * ( splat(1.0/3628800.0) +
+          z * ( splat(1.0/479001600.0) +
+          z * ( splat(1.0/87178291200.0) +
+          z * ( splat(1.0/20922789888000.0) +
+          z *   splat(1.0/6402373705728000.0) ) ) ) ) ) ) ) );
+        VD d  = splat(-2.0/6.0) +
+          z * ( splat(-4.0/120.0) +
+          z * ( splat(-6.0/5040.0) +
+          z * ( splat(-8.0/362880.0) +
+          z * ( splat(-10.0/39916800.0) +
+          z * ( splat(-12.0/6227020800.0) +
+          z * ( splat(-14.0/1307674368000.0) +
+          z * ( splat(-16.0/355687428096000.0) +
+          z *   splat(-18.0/121645100408832000.0) ) ) ) ) ) ) );
+        VD rs = ax + ( ax * z ) * ( d / ( splat(1.0) + cm ) );
+        // |x| >= 1: 1-2/(exp(2|x|)+1), exactly 1 from 22 on
+        VL dummy;
+        VD e  = exp( splat(2.0) * select( ax < splat(22.0), ax, splat(22.0) ), dummy );
+        VD rl = splat(1.0) - splat(2.0) / ( e + splat(1.0) );
+        return copysign( select( ax < splat(1.0), rs, rl ), x );
+      }
+
+      /*
+       * pow of fdlibm for x positive and normal, |y| < 2^31 and a
+       * normal result: log2(x) in extended precision (t1+t2), times y
+       * split in y1+y2, then 2^(p_h+p_l) with the exp polynomial.
+       */
+      static CALC_SIMD_INLINE VD
+      pow( VD const & x, VD const & y, VL & special ) {
+        VD const one = splat(1.0);
+        special = ~( x >= splat(2.2250738585072014e-308) &&
+                     x <= splat(1.7976931348623157e+308) &&
+                     fabs(y) < splat(2147483648.0) );
+        VL hx = (VL)x >> 32;
+        VL n  = ( hx >> 20 ) - splat(int64_t(0x3ff));
+        VL j  = hx & splat(int64_t(0x000fffff));
+        VL ix = j | splat(int64_t(0x3ff00000));
+        // mantissa reduced around 1 (k = 0) or 1.5 (k = 1)
+        VL k1  = j > splat(int64_t(0x3988E)) && j < splat(int64_t(0xBB67A));
+        VL big = j >= splat(int64_t(0xBB67A));
+        n  = n - big;
+        ix = ix + ( big & splat(int64_t(-0x00100000)) );
+        VD ax   = (VD)( ( ix << 32 ) | ( (VL)x & splat(int64_t(0xFFFFFFFF)) ) );
+        VD bp   = select( k1, splat(1.5), one );
+        VD dp_h = select( k1, splat(5.84962487220764160156e-01), splat(0.0) );
+        VD dp_l = select( k1, splat(1.35003920212974897128e-08), splat(0.0) );
+
+        // ss = s_h+s_l = (ax-bp)/(ax+bp)
+        VD u   = ax - bp;
+        VD v   = one / ( ax + bp );
+        VD ss  = u * v;
+        VD s_h = clear_low( ss );
+        VD t_h = (VD)( ( ( ( ix >> 1 ) | splat(int64_t(0x20000000)) ) +
+                         splat(int64_t(0x00080000)) +
+                         ( k1 & splat(int64_t(1)<<18) ) ) << 32 );
+        VD t_l = ax - ( t_h - bp );
+        VD s_l = v * ( ( u - s_h * t_h ) - s_h * t_l );
+
+        // log(ax)
+        VD s2 = ss * ss;
+        VD r  = s2 * s2 * ( splat(5.99999999999994648725e-01) +
+                s2 * ( splat(4.28571428578550184252e-01) +
+                s2 * ( splat(3.33333329818377432918e-01) +
+                s2 * ( splat(2.72728123808534006489e-01) +
+                s2 * ( splat(2.30660745775561754067e-01) +
+                s2 *   splat(2.06975017800338417784e-01) ) ) ) ) );
+        r   = r + s_l * ( s_h + ss );
+        s2  = s_h * s_h;
+        t_h = clear_low( splat(3.0) + s2 + r );
+        t_l = r - ( ( t_h - splat(3.0) ) - s2 );
+        u   = s_h * t_h;
+        v   = s_l * t_h + t_l * ss;
+        VD p_h = clear_low( u + v );
+        VD p_l = v - ( p_h - u );
+        // log2(ax) = n + dp_h + z_h + z_l = t1 + t2
+        VD z_h = splat(9.61796700954437255859e-01) * p_h;
+        VD z_l = splat(-7.02846165095275826516e-09) * p_h +
+                 p_l * splat(9.61796693925975554329e-01) + dp_l;
+        VD t   = to_double( n );
+        VD t1  = clear_low( ( ( z_h + z_l ) + dp_h ) + t );
+        VD t2  = z_l - ( ( ( t1 - t ) - dp_h ) - z_h );
+
+        // (y1+y2)*(t1+t2)
+        VD y1 = clear_low( y );
+        p_l = ( y - y1 ) * t1 + y * t2;
+        p_h = y1 * t1;
+        VD z = p_l + p_h;
+        special = special | ~( fabs(z) < splat(1020.0) ); // normal result
+
+        // 2^(p_h+p_l) = 2^m * 2^(p_h+p_l-m)
+        VL m;
+        p_h = p_h - round( select( special, splat(0.0), z ), m );
+        t   = clear_low( p_l + p_h );
+        u   = t * splat(6.93147182464599609375e-01);
+        v   = ( p_l - ( t - p_h ) ) * splat(6.93147180559945286227e-01) +
+              t * splat(-1.90465429995776804525e-09);
+        z   = u + v;
+        VD w = v - ( z - u );
+        t   = z * z;
+        t1  = z - t * ( splat(1.66666666666666019037e-01) +
+                  t * ( splat(-2.77777777770155933842e-03) +
+                  t * ( splat(6.61375632143793436117e-05) +
+                  t * ( splat(-1.65339022054652515390e-06) +
+                  t *   splat(4.13813679705723846039e-08) ) ) ) );
+        r   = ( z * t1 ) / ( t1 - splat(2.0) ) - ( w + z * w );
+        z   = one - ( r - z );
+        return (VD)( (VL)z + ( m << 52 ) );
+      }
+    };
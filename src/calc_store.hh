@@ -0,0 +1,312 @@
+/*--------------------------------------------------------------------------*\
+ |                                                                          |
+ |  This program is free software; you can redistribute it and/or modify    |
+ |  it under the terms of the GNU General Public License as published by    |
+ |  the Free Software Foundation; either version 2, or (at your option)     |
+ |  any later version.                                                      |
+ |                                                                          |
+ |  This program is distributed in the hope that it will be useful,         |
+ |  but WITHOUT ANY WARRANTY; without even the implied warranty of          |
+ |  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           |
+ |  GNU General Public License for more details.                            |
+ |                                                                          |
+ |  You should have received a copy of the GNU General Public License       |
+ |  along with this program; if not, write to the Free Software             |
+ |  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.               |
+ |                                                                          |
+ |  Copyright (C) 1999                                                      |
+ |                                                                          |
+ |            ___    ____  ___  __  __        ___    ____  ___  __  __      |
+ |           /   \  /     /   \  \  /        /   \  /     /   \  \  /       |
+ |          /____/ /__   /____/   \/        /____/ /__   /____/   \/        |
+ |         /   \  /     /   \     /        /   \  /     /   \     /         |
+ |        /____/ /____ /    /    /        /____/ /____ /    /    /          |
+ |                                                                          |
+ |      Enrico Bertolazzi                                                   |
+ |      Dipartimento di Ingegneria Meccanica e Strutturale                  |
+ |      Universita` degli Studi di Trento                                   |
+ |      Via Mesiano 77, I-38050 Trento, Italy                               |
+ |                                                                          |
+\*--------------------------------------------------------------------------*/
+
+
+#ifndef CALC_STORE_HH
+#define CALC_STORE_HH
+
+#include "calc.hh"
+
+// requires C++11 for the atomic support
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <functional>
+
+namespace calc_defs {
+
+  using namespace ::std;
+
+  /*!
+   * Versioned set of variables shared between one or more writers and
+   * many concurrent readers.
+   *
+   * Writers never modify a published set: each update copies the
+   * current set, modifies the copy and publishes it with an atomic
+   * pointer swap (writers are serialized by a mutex).  Readers pin the
+   * current version without locks and evaluate against it through
+   * `Calculator::variables_attach`, so they see all or nothing of each
+   * update.  A replaced version is deleted by the writers as soon as
+   * no reader has it pinned (hazard pointers).
+   */
+  template <typename T_type = double>
+  class Variable_store {
+
+  public:
+
+    typedef T_type                             value_type;
+    typedef Calculator<value_type>             CALCULATOR;
+    typedef typename CALCULATOR::map_real      map_real;
+    typedef function<void(map_real & vars)>    Updater;
+
+    //! an immutable published set of variables
+    typedef struct {
+      map_real      vars;
+      unsigned long number; //!< increased by one at each update
+    } Version;
+
+  private:
+
+    // hazard pointer of a reader, the slots are never freed
+    // before the store so that the list can be scanned without locks
+    struct Slot {
+      atomic<Version*> hazard;
+      atomic<bool>     in_use;
+      Slot *           next;
+      Slot() : hazard(nullptr), in_use(true), next(nullptr) {}
+    };
+
+    atomic<Version*>      current;
+    atomic<unsigned long> number; // of the current version, readable without pinning
+    atomic<Slot*>         slots;
+    mutex            writer;
+    vector<Version*> retired;
+
+    Variable_store( Variable_store const & );
+    Variable_store const & operator = ( Variable_store const & );
+
+    Slot * slot_acquire();
+
+    Version const * pin( Slot * s ) const;
+
+    // called with the writer mutex held
+    void publish( Version * v );
+    void reclaim();
+
+  public:
+
+    /*!
+     * Pins a version of the store for the evaluation in a thread.
+     * A reader must be used by one thread at a time and must be
+     * destroyed before the store.
+     */
+    class Reader {
+
+      Variable_store & store;
+      Slot *           slot;
+      Version const *  pinned;
+
+      Reader( Reader const & );
+      Reader const & operator = ( Reader const & );
+
+    public:
+
+      explicit
+      Reader( Variable_store & s )
+      : store(s), slot(s.slot_acquire()), pinned(nullptr)
+      {}
+
+      ~Reader() {
+        release();
+        slot -> in_use . store( false );
+      }
+
+      /*!
+       *  Pin the current version (releasing the previous one), it
+       *  stays valid until the next `acquire` or `release`.
+       */
+      Version const &
+      acquire()
+      { pinned = store.pin(slot); return *pinned; }
+
+      //! allow the pinned version to be deleted
+      void
+      release()
+      { slot -> hazard . store( nullptr ); pinned = nullptr; }
+
+      /*!
+       *  Parse an expression against the current version: the
+       *  variables assigned by the expression stay in the evaluator
+       *  and shadow the ones of the store.
+       *  \param ee   the evaluator
+       *  \param expr the expression
+       *  \return the value returned by `ee.parse`
+       */
+      bool
+      parse( CALCULATOR & ee, string const & expr ) {
+        ee . variables_attach( &acquire() . vars );
+        bool ok = ee . parse( expr );
+        ee . variables_attach( nullptr );
+        release();
+        return ok;
+      }
+
+    };
+
+    Variable_store();
+    explicit Variable_store( map_real const & vars );
+    ~Variable_store();
+
+    //! set (add) a variable
+    void
+    set( string const & name, value_type val )
+    { update( [&]( map_real & vars ) { vars[name] = val; } ); }
+
+    //! remove a variable
+    void
+    drop( string const & name )
+    { update( [&]( map_real & vars ) { vars . erase(name); } ); }
+
+    //! add the variables, overwriting the ones with the same name
+    void
+    variables_merge( map_real const & m ) {
+      update( [&]( map_real & vars ) {
+        for ( typename map_real::const_iterator ii = m . begin();
+              ii != m . end(); ++ii )
+          vars[ii -> first] = ii -> second;
+      } );
+    }
+
+    /*!
+     *  Publish a new version modified by `fun` in a single step,
+     *  readers see either none or all of the changes.
+     */
+    void update( Updater const & fun );
+
+    //! number of the current version
+    unsigned long
+    version() const
+    { return number . load(); }
+
+    //! number of replaced versions still pinned by some reader
+    size_t
+    retired_count() {
+      lock_guard<mutex> lock(writer);
+      return retired . size();
+    }
+
+  };
+
+  template <typename T_type>
+  Variable_store<T_type>::Variable_store()
+  : current(new Version()), number(0), slots(nullptr), writer(), retired()
+  { current . load() -> number = 0; }
+
+  template <typename T_type>
+  Variable_store<T_type>::Variable_store( map_real const & vars )
+  : current(new Version()), number(0), slots(nullptr), writer(), retired() {
+    current . load() -> vars   = vars;
+    current . load() -> number = 0;
+  }
+
+  template <typename T_type>
+  Variable_store<T_type>::~Variable_store() {
+    delete current . load();
+    for ( size_t i = 0; i < retired . size(); ++i ) delete retired[i];
+    Slot * s = slots . load();
+    while ( s != nullptr ) { Slot * n = s -> next; delete s; s = n; }
+  }
+
+  template <typename T_type>
+  typename Variable_store<T_type>::Slot *
+  Variable_store<T_type>::slot_acquire() {
+    // reuse a free slot
+    for ( Slot * s = slots . load(); s != nullptr; s = s -> next ) {
+      bool expected = false;
+      if ( s -> in_use . compare_exchange_strong( expected, true ) ) return s;
+    }
+    // or push a new one at the head of the list
+    Slot * s = new Slot();
+    s -> next = slots . load();
+    while ( !slots . compare_exchange_weak( s -> next, s ) ) {}
+    return s;
+  }
+
+  template <typename T_type>
+  typename Variable_store<T_type>::Version const *
+  Variable_store<T_type>::pin( Slot * s ) const {
+    // the version can be retired between the load and the store of
+    // the hazard: read again until it is still current after
+    // the hazard is visible to the writers
+    Version * v = current . load();
+    for (;;) {
+      s -> hazard . store( v );
+      Version * w = current . load();
+      if ( w == v ) return v;
+      v = w;
+    }
+  }
+
+  template <typename T_type>
+  void
+  Variable_store<T_type>::publish( Version * v ) {
+    Version * old = current . load();
+    v -> number = old -> number + 1;
+    current . store( v );
+    number . store( v -> number );
+    retired . push_back( old );
+    reclaim();
+  }
+
+  template <typename T_type>
+  void
+  Variable_store<T_type>::reclaim() {
+    vector<Version*> hazards;
+    for ( Slot * s = slots . load(); s != nullptr; s = s -> next ) {
+      Version * h = s -> hazard . load();
+      if ( h != nullptr ) hazards . push_back( h );
+    }
+    size_t j = 0;
+    for ( size_t i = 0; i < retired . size(); ++i ) {
+      bool pinned = false;
+      for ( size_t k = 0; k < hazards . size() && !pinned; ++k )
+        pinned = hazards[k] == retired[i];
+      if ( pinned ) retired[j++] = retired[i];
+      else          delete retired[i];
+    }
+    retired . resize( j );
+  }
+
+  template <typename T_type>
+  void
+  Variable_store<T_type>::update( Updater const & fun ) {
+    lock_guard<mutex> lock(writer);
+    Version * v = new Version( *current . load() );
+    try {
+      fun( v -> vars );
+    } catch (...) {
+      delete v;
+      throw;
+    }
+    publish( v );
+  }
+
+  // end class Variable_store
+
+} // end namespace
+
+namespace calc_load {
+  using calc_defs::Variable_store;
+}
+
+#endif
+
+// end of file: calc_store.hh
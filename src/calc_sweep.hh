@@ -0,0 +1,456 @@
+/*--------------------------------------------------------------------------*\
+ |                                                                          |
+ |  This program is free software; you can redistribute it and/or modify    |
+ |  it under the terms of the GNU General Public License as published by    |
+ |  the Free Software Foundation; either version 2, or (at your option)     |
+ |  any later version.                                                      |
+ |                                                                          |
+ |  This program is distributed in the hope that it will be useful,         |
+ |  but WITHOUT ANY WARRANTY; without even the implied warranty of          |
+ |  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           |
+ |  GNU General Public License for more details.                            |
+ |                                                                          |
+ |  You should have received a copy of the GNU General Public License       |
+ |  along with this program; if not, write to the Free Software             |
+ |  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.               |
+ |                                                                          |
+ |  Copyright (C) 1999                                                      |
+ |                                                                          |
+ |            ___    ____  ___  __  __        ___    ____  ___  __  __      |
+ |           /   \  /     /   \  \  /        /   \  /     /   \  \  /       |
+ |          /____/ /__   /____/   \/        /____/ /__   /____/   \/        |
+ |         /   \  /     /   \     /        /   \  /     /   \     /         |
+ |        /____/ /____ /    /    /        /____/ /____ /    /    /          |
+ |                                                                          |
+ |      Enrico Bertolazzi                                                   |
+ |      Dipartimento di Ingegneria Meccanica e Strutturale                  |
+ |      Universita` degli Studi di Trento                                   |
+ |      Via Mesiano 77, I-38050 Trento, Italy                               |
+ |                                                                          |
+\*--------------------------------------------------------------------------*/
+
+
+#ifndef CALC_SWEEP_HH
+#define CALC_SWEEP_HH
+
+#include "calc.hh"
+#include "calc_batch.hh"
+
+// requires C++11 for the thread support
+#include <vector>
+#include <limits>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <cstdint>
+
+namespace calc_defs {
+
+  using namespace ::std;
+
+  /*!
+   * This class evaluates an expression over all the combinations of
+   * a set of parameters (design of experiments sweeps).
+   *
+   * The points are numbered in row major order (the last added
+   * parameter varies fastest) and split in chunks of consecutive
+   * points, which are distributed among the threads by a work
+   * stealing scheduler.  Each thread evaluates with its own copy of
+   * the base evaluator, so user functions must be reentrant.  When the
+   * expression can be compiled into a Program each chunk is evaluated
+   * at once with the array versions of the builtin functions,
+   * otherwise the expression is parsed at each point.
+   */
+  template <typename T_type = double>
+  class Sweep {
+
+  public:
+
+    typedef T_type                 value_type;
+    typedef value_type*            pointer;
+    typedef const value_type*      const_pointer;
+    typedef Calculator<value_type> CALCULATOR;
+    typedef Program<value_type>    PROGRAM;
+
+    typedef enum {
+      Grid, //!< Cartesian product of the parameter values
+      Zip   //!< parameter values taken in parallel (same length lists)
+    } Mode;
+
+    /*!
+     *  Called (concurrently, from the worker threads) with the values
+     *  computed for the points `first`, ..., `first+count-1`.
+     *  Points with evaluation errors have `NaN` value.
+     */
+    typedef function<void(size_t first, size_t count, const_pointer res)> Consumer;
+
+    //! Reductions over the points evaluated without errors to a number
+    typedef struct {
+      size_t     n_points; //!< number of points in the reductions
+      size_t     n_errors; //!< number of points with evaluation errors
+      size_t     n_nans;   //!< number of points evaluated to NaN without errors
+      value_type min;
+      value_type max;
+      value_type sum;
+      size_t     argmin;   //!< lowest index of the minimum
+      size_t     argmax;   //!< lowest index of the maximum
+    } Result;
+
+  private:
+
+    typedef struct {
+      string             name;
+      vector<value_type> values;
+    } Axis;
+
+    // range of chunks [lo,hi) owned by a thread, packed as hi<<32|lo
+    // so that the owner and the thieves update it with a single CAS
+    struct alignas(64) Chunk_range {
+      atomic<uint64_t> span;
+      Chunk_range() : span(0) {}
+    };
+
+    static uint64_t pack( uint64_t lo, uint64_t hi ) { return (hi<<32)|lo; }
+    static uint64_t lo_of( uint64_t s ) { return s & 0xFFFFFFFFu; }
+    static uint64_t hi_of( uint64_t s ) { return s >> 32; }
+
+    CALCULATOR const & base;
+    vector<Axis>       axes;
+    Mode               mode;
+    unsigned           n_threads;
+    size_t             chunk;
+
+    Sweep( Sweep const & );
+    Sweep const & operator = ( Sweep const & );
+
+    static bool pop( Chunk_range & r, size_t & c );
+    static bool steal( Chunk_range & victim, Chunk_range & thief );
+
+    void
+    worker(
+      unsigned              id,
+      string const &        expr,
+      vector<Chunk_range> & ranges,
+      pointer               out,
+      Consumer const &      consumer,
+      Result &              res
+    ) const;
+
+  public:
+
+    /*!
+     *  \param ee the evaluator providing user functions and variables,
+     *            it must not be modified while `run` is executing
+     */
+    explicit
+    Sweep( CALCULATOR const & ee )
+    : base(ee)
+    , axes()
+    , mode(Grid)
+    , n_threads(0)
+    , chunk(256)
+    {}
+
+    //! remove all the parameters
+    void clear() { axes.clear(); }
+
+    /*!
+     *  Add a parameter taking `n` equally spaced values in `[a,b]`
+     */
+    void add_range( string const & name, value_type a, value_type b, size_t n );
+
+    /*!
+     *  Add a parameter taking the listed values
+     */
+    void
+    add_list( string const & name, vector<value_type> const & values ) {
+      axes.push_back( Axis() );
+      axes.back().name   = name;
+      axes.back().values = values;
+    }
+
+    void set_mode( Mode m ) { mode = m; }
+
+    //! number of threads, 0 means all the hardware threads
+    void set_threads( unsigned n ) { n_threads = n; }
+
+    //! number of consecutive points assigned to a thread at once
+    void set_chunk( size_t n ) { chunk = n > 0 ? n : 1; }
+
+    //! \return the number of points of the sweep
+    size_t size() const;
+
+    /*!
+     *  Compute the parameters values of a point
+     *  \param idx    the index of the point
+     *  \param values the values, in the order the parameters were added
+     */
+    void point( size_t idx, pointer values ) const;
+
+    /*!
+     *  Evaluate the expression on all the points.
+     *  \param expr     the expression, possibly with assignments; the
+     *                  value of the last statement is the result
+     *  \param res      reductions over the results
+     *  \param out      if not null, the result of point `i` is stored in `out[i]`
+     *  \param consumer if not empty, receives the results chunk by chunk
+     *  \return false if some point was not evaluated due to errors
+     */
+    bool
+    run(
+      string const &   expr,
+      Result &         res,
+      pointer          out      = nullptr,
+      Consumer const & consumer = Consumer()
+    ) const;
+
+  };
+
+  template <typename T_type>
+  void
+  Sweep<T_type>::add_range(
+    string const & name,
+    value_type     a,
+    value_type     b,
+    size_t         n
+  ) {
+    vector<value_type> values(n);
+    for ( size_t i = 0; i < n; ++i )
+      values[i] = n > 1 ? a + ((b-a)*value_type(i))/value_type(n-1) : a;
+    add_list( name, values );
+  }
+
+  template <typename T_type>
+  size_t
+  Sweep<T_type>::size() const {
+    if ( axes.empty() ) return 0;
+    size_t n = axes[0].values.size();
+    for ( size_t k = 1; k < axes.size(); ++k ) {
+      size_t nk = axes[k].values.size();
+      if ( mode == Grid ) n *= nk;
+      else if ( nk < n )  n  = nk;
+    }
+    return n;
+  }
+
+  template <typename T_type>
+  void
+  Sweep<T_type>::point( size_t idx, pointer values ) const {
+    for ( size_t k = axes.size(); k-- > 0; ) {
+      vector<value_type> const & v = axes[k].values;
+      if ( mode == Grid ) {
+        values[k] = v[idx % v.size()];
+        idx /= v.size();
+      } else {
+        values[k] = v[idx];
+      }
+    }
+  }
+
+  template <typename T_type>
+  bool
+  Sweep<T_type>::pop( Chunk_range & r, size_t & c ) {
+    uint64_t s = r.span.load();
+    for (;;) {
+      uint64_t lo = lo_of(s), hi = hi_of(s);
+      if ( lo >= hi ) return false;
+      if ( r.span.compare_exchange_weak( s, pack(lo+1,hi) ) ) {
+        c = size_t(lo);
+        return true;
+      }
+    }
+  }
+
+  // move the upper half of the victim chunks to the (empty) thief range
+  template <typename T_type>
+  bool
+  Sweep<T_type>::steal( Chunk_range & victim, Chunk_range & thief ) {
+    uint64_t s = victim.span.load();
+    for (;;) {
+      uint64_t lo = lo_of(s), hi = hi_of(s);
+      if ( lo >= hi ) return false;
+      uint64_t mid = hi - (hi-lo+1)/2;
+      if ( victim.span.compare_exchange_weak( s, pack(lo,mid) ) ) {
+        thief.span.store( pack(mid,hi) );
+        return true;
+      }
+    }
+  }
+
+  template <typename T_type>
+  void
+  Sweep<T_type>::worker(
+    unsigned              id,
+    string const &        expr,
+    vector<Chunk_range> & ranges,
+    pointer               out,
+    Consumer const &      consumer,
+    Result &              res
+  ) const {
+    CALCULATOR ee;
+    ee.symbols_merge( base );
+
+    size_t const       npts  = size();
+    size_t const       naxes = axes.size();
+    vector<size_t>     digit(naxes);
+    vector<value_type> values(chunk);
+    value_type const   nan = numeric_limits<value_type>::quiet_NaN();
+
+    // evaluate a chunk at once when the expression can be compiled,
+    // otherwise parse it at each point
+    vector<string> names(naxes);
+    for ( size_t k = 0; k < naxes; ++k ) names[k] = axes[k].name;
+    PROGRAM            prog;
+    bool const         batch = prog.compile( ee, expr, names );
+    vector<value_type> columns( batch ? naxes*chunk : 0 );
+    vector<char>       errors(chunk);
+    vector<const_pointer> cols(naxes);
+    for ( size_t k = 0; k < naxes && batch; ++k ) cols[k] = &columns[k*chunk];
+    typename PROGRAM::Workspace ws;
+
+    unsigned const nr = unsigned(ranges.size());
+    size_t   c;
+    for (;;) {
+      if ( !pop( ranges[id], c ) ) {
+        // look for work in the other threads
+        bool found = false;
+        for ( unsigned k = 1; k < nr && !found; ++k )
+          found = steal( ranges[(id+k)%nr], ranges[id] );
+        if ( !found ) break;
+        continue;
+      }
+
+      size_t first = c*chunk;
+      size_t count = min( chunk, npts-first );
+
+      // digits of the first point of the chunk
+      size_t idx = first;
+      for ( size_t k = naxes; k-- > 0; ) {
+        vector<value_type> const & v = axes[k].values;
+        if ( mode == Grid ) { digit[k] = idx % v.size(); idx /= v.size(); }
+        else                digit[k] = first;
+      }
+
+      for ( size_t i = 0; i < count; ++i ) {
+        if ( i > 0 ) {
+          // advance to the next point
+          if ( mode == Grid ) {
+            size_t k = naxes;
+            while ( k-- > 0 ) {
+              if ( ++digit[k] < axes[k].values.size() ) break;
+              digit[k] = 0;
+            }
+          } else {
+            for ( size_t k = 0; k < naxes; ++k ) ++digit[k];
+          }
+        }
+        if ( batch ) {
+          for ( size_t k = 0; k < naxes; ++k )
+            columns[k*chunk+i] = axes[k].values[digit[k]];
+        } else {
+          // all the parameters are set again: the expression may assign them
+          for ( size_t k = 0; k < naxes; ++k )
+            ee.set( axes[k].name, axes[k].values[digit[k]] );
+          errors[i] = ee.parse( expr ) ? 1 : 0;
+          values[i] = ee.get_value();
+        }
+      }
+
+      if ( batch )
+        prog.eval( count, &cols.front(), &values.front(), &errors.front(), ws );
+
+      for ( size_t i = 0; i < count; ++i ) {
+        if ( errors[i] ) {
+          values[i] = nan;
+          ++res.n_errors;
+          continue;
+        }
+        value_type v = values[i];
+        size_t     j = first+i;
+        if ( v != v ) { ++res.n_nans; continue; } // e.g. sqrt(-1)
+        if ( res.n_points == 0 ) {
+          res.min = res.max = v;
+          res.argmin = res.argmax = j;
+        } else {
+          if ( v < res.min || (v == res.min && j < res.argmin) )
+            { res.min = v; res.argmin = j; }
+          if ( v > res.max || (v == res.max && j < res.argmax) )
+            { res.max = v; res.argmax = j; }
+        }
+        res.sum += v;
+        ++res.n_points;
+      }
+
+      if ( out != nullptr )
+        for ( size_t i = 0; i < count; ++i ) out[first+i] = values[i];
+      if ( consumer ) consumer( first, count, &values.front() );
+    }
+  }
+
+  template <typename T_type>
+  bool
+  Sweep<T_type>::run(
+    string const &   expr,
+    Result &         res,
+    pointer          out,
+    Consumer const & consumer
+  ) const {
+    Result const zero = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    res = zero;
+
+    size_t npts = size();
+    if ( npts == 0 ) return true;
+
+    size_t   nchunks = (npts+chunk-1)/chunk;
+    unsigned nt      = n_threads;
+    if ( nt == 0 ) nt = thread::hardware_concurrency();
+    if ( nt == 0 ) nt = 1;
+    if ( nt > nchunks ) nt = unsigned(nchunks);
+
+    // initial static partition of the chunks, stealing balances the load
+    vector<Chunk_range> ranges(nt);
+    for ( unsigned t = 0; t < nt; ++t )
+      ranges[t].span.store( pack( (nchunks*t)/nt, (nchunks*(t+1))/nt ) );
+
+    vector<Result> partial( nt, zero );
+    vector<thread> threads;
+    for ( unsigned t = 1; t < nt; ++t )
+      threads.push_back(
+        thread( &Sweep::worker, this, t, cref(expr), ref(ranges),
+                out, cref(consumer), ref(partial[t]) )
+      );
+    worker( 0, expr, ranges, out, consumer, partial[0] );
+    for ( size_t t = 0; t < threads.size(); ++t ) threads[t].join();
+
+    // combine the partial reductions
+    for ( unsigned t = 0; t < nt; ++t ) {
+      Result const & p = partial[t];
+      res.n_errors += p.n_errors;
+      res.n_nans   += p.n_nans;
+      if ( p.n_points == 0 ) continue;
+      if ( res.n_points == 0 ) {
+        res.min    = p.min;    res.max    = p.max;
+        res.argmin = p.argmin; res.argmax = p.argmax;
+      } else {
+        if ( p.min < res.min || (p.min == res.min && p.argmin < res.argmin) )
+          { res.min = p.min; res.argmin = p.argmin; }
+        if ( p.max > res.max || (p.max == res.max && p.argmax < res.argmax) )
+          { res.max = p.max; res.argmax = p.argmax; }
+      }
+      res.sum      += p.sum;
+      res.n_points += p.n_points;
+    }
+    return res.n_errors == 0;
+  }
+
+  // end class Sweep
+
+} // end namespace
+
+namespace calc_load {
+  using calc_defs::Sweep;
+}
+
+#endif
+
+// end of file: calc_sweep.hh
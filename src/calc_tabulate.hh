@@ -0,0 +1,419 @@
+/*--------------------------------------------------------------------------*\
+ |                                                                          |
+ |  This program is free software; you can redistribute it and/or modify    |
+ |  it under the terms of the GNU General Public License as published by    |
+ |  the Free Software Foundation; either version 2, or (at your option)     |
+ |  any later version.                                                      |
+ |                                                                          |
+ |  This program is distributed in the hope that it will be useful,         |
+ |  but WITHOUT ANY WARRANTY; without even the implied warranty of          |
+ |  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           |
+ |  GNU General Public License for more details.                            |
+ |                                                                          |
+ |  You should have received a copy of the GNU General Public License       |
+ |  along with this program; if not, write to the Free Software             |
+ |  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.               |
+ |                                                                          |
+ |  Copyright (C) 1999                                                      |
+ |                                                                          |
+ |            ___    ____  ___  __  __        ___    ____  ___  __  __      |
+ |           /   \  /     /   \  \  /        /   \  /     /   \  \  /       |
+ |          /____/ /__   /____/   \/        /____/ /__   /____/   \/        |
+ |         /   \  /     /   \     /        /   \  /     /   \     /         |
+ |        /____/ /____ /    /    /        /____/ /____ /    /    /          |
+ |                                                                          |
+ |      Enrico Bertolazzi                                                   |
+ |      Dipartimento di Ingegneria Meccanica e Strutturale                  |
+ |      Universita` degli Studi di Trento                                   |
+ |      Via Mesiano 77, I-38050 Trento, Italy                               |
+ |                                                                          |
+\*--------------------------------------------------------------------------*/
+
+
+#ifndef CALC_TABULATE_HH
+#define CALC_TABULATE_HH
+
+#include "calc.hh"
+
+#include <vector>
+
+namespace calc_defs {
+
+  using namespace ::std;
+
+  /*!
+   * Approximation of an expensive smooth unary function on an interval
+   * `[a,b]` by piecewise cubic interpolation on a uniform grid.  The
+   * grid is refined until the error, checked against the exact
+   * function at three points inside each interval, satisfies
+   *
+   *   |p(x)-f(x)| <= tol * max(1,|f(x)|)
+   *
+   * Outside `[a,b]` the exact function is called.  Register it in
+   * place of the exact function with `Calculator::set_unary_fun`;
+   * the evaluation does not modify the object, so it can be shared
+   * among threads.
+   */
+  template <typename T_type = double>
+  class Tabulated1 : public Unary_function<T_type> {
+
+  public:
+
+    typedef T_type                 value_type;
+    typedef value_type*            pointer;
+    typedef const value_type*      const_pointer;
+    typedef value_type (*Func1)(value_type);
+
+  private:
+
+    Func1              fun;
+    value_type         a, b, h, inv_h, max_err;
+    int                n_cells;
+    vector<value_type> coeffs; // 4 per cell, p(t) = c0+t*(c1+t*(c2+t*c3))
+
+    static value_type mixed_error( value_type p, value_type f ) {
+      value_type e = p > f ? p - f : f - p;
+      value_type s = f > 0 ? f : -f;
+      return s > 1 ? e / s : e;
+    }
+
+    bool sample( int n, vector<value_type> & f ) const;
+    void setup( int n, vector<value_type> const & f );
+    value_type check() const;
+
+    Tabulated1( Tabulated1 const & );
+    Tabulated1 const & operator = ( Tabulated1 const & );
+
+  public:
+
+    Tabulated1()
+    : fun(0), a(0), b(0), h(0), inv_h(0), max_err(0), n_cells(0), coeffs()
+    {}
+
+    /*!
+     *  Build the table
+     *  \param f         the exact function
+     *  \param a0        left extreme of the interval
+     *  \param b0        right extreme of the interval
+     *  \param tol       required tolerance
+     *  \param max_cells maximum number of intervals of the grid
+     *  \return true if the tolerance is reached, false if the grid
+     *          would exceed `max_cells` (the finest table is kept) or
+     *          if `f` is not finite on the grid (the exact function is
+     *          used everywhere)
+     */
+    bool
+    build(
+      Func1      f,
+      value_type a0,
+      value_type b0,
+      value_type tol,
+      int        max_cells = 1<<20
+    );
+
+    //! \return the maximum error measured when building
+    value_type error_estimate() const { return max_err; }
+
+    //! \return the number of intervals of the grid
+    int cells() const { return n_cells; }
+
+    //! \return the size of the table in bytes
+    size_t memory() const { return coeffs.size()*sizeof(value_type); }
+
+    //! \return the exact value of the function
+    value_type exact( value_type x ) const { return fun(x); }
+
+    value_type
+    eval( value_type x ) {
+      if ( !( x >= a && x <= b ) || n_cells == 0 ) return fun(x);
+      value_type s = (x-a)*inv_h;
+      int        i = int(s);
+      if ( i >= n_cells ) i = n_cells-1;
+      value_type t = s - i;
+      const_pointer c = &coeffs[4*size_t(i)];
+      return c[0]+t*(c[1]+t*(c[2]+t*c[3]));
+    }
+
+    void
+    eval( int n, const_pointer x, pointer y )
+    { for ( int i = 0; i < n; ++i ) y[i] = eval(x[i]); }
+
+  };
+
+  template <typename T_type>
+  bool
+  Tabulated1<T_type>::sample( int n, vector<value_type> & f ) const {
+    f.resize(n+1);
+    for ( int i = 0; i <= n; ++i ) {
+      f[i] = fun( i < n ? a + i*((b-a)/n) : b );
+      if ( !( f[i] - f[i] == 0 ) ) return false; // not finite
+    }
+    return true;
+  }
+
+  // cubic interpolation of 4 consecutive nodes, the interior cells use
+  // the nodes i-1,...,i+2, the first and the last cells are one sided
+  template <typename T_type>
+  void
+  Tabulated1<T_type>::setup( int n, vector<value_type> const & f ) {
+    n_cells = n;
+    h       = (b-a)/n;
+    inv_h   = n/(b-a);
+    coeffs.resize(4*size_t(n));
+    for ( int i = 0; i < n; ++i ) {
+      pointer c = &coeffs[4*size_t(i)];
+      if ( i == 0 || i == n-1 ) {
+        // forward differences from the extreme node, for the last cell
+        // in the reversed variable 1-t
+        value_type g0, g1, g2, g3;
+        if ( i == 0 ) { g0 = f[0]; g1 = f[1];   g2 = f[2];   g3 = f[3];   }
+        else          { g0 = f[n]; g1 = f[n-1]; g2 = f[n-2]; g3 = f[n-3]; }
+        value_type d1 = g1-g0, d2 = g2-2*g1+g0, d3 = g3-3*g2+3*g1-g0;
+        value_type q0 = g0, q1 = d1-d2/2+d3/3, q2 = (d2-d3)/2, q3 = d3/6;
+        if ( i == 0 ) {
+          c[0] = q0; c[1] = q1; c[2] = q2; c[3] = q3;
+        } else {
+          c[0] = q0+q1+q2+q3;
+          c[1] = -q1-2*q2-3*q3;
+          c[2] = q2+3*q3;
+          c[3] = -q3;
+        }
+      } else {
+        value_type fm = f[i-1], f0 = f[i], f1 = f[i+1], f2 = f[i+2];
+        c[0] = f0;
+        c[1] = -fm/3-f0/2+f1-f2/6;
+        c[2] = fm/2-f0+f1/2;
+        c[3] = (f2-fm)/6+(f0-f1)/2;
+      }
+    }
+  }
+
+  template <typename T_type>
+  typename Tabulated1<T_type>::value_type
+  Tabulated1<T_type>::check() const {
+    value_type err = 0;
+    for ( int i = 0; i < n_cells; ++i ) {
+      const_pointer c = &coeffs[4*size_t(i)];
+      for ( int k = 1; k <= 3; ++k ) {
+        value_type t = value_type(k)/4;
+        value_type e = mixed_error( c[0]+t*(c[1]+t*(c[2]+t*c[3])), fun(a+(i+t)*h) );
+        if ( !( e <= err ) ) err = e; // NaN propagates
+      }
+    }
+    return err;
+  }
+
+  template <typename T_type>
+  bool
+  Tabulated1<T_type>::build(
+    Func1      f,
+    value_type a0,
+    value_type b0,
+    value_type tol,
+    int        max_cells
+  ) {
+    fun     = f;
+    a       = a0;
+    b       = b0;
+    n_cells = 0;
+    coeffs.clear();
+    if ( !( b > a ) || max_cells < 3 ) return false;
+
+    vector<value_type> fv;
+    int n = max_cells < 16 ? max_cells : 16;
+    for (;;) {
+      if ( !sample( n, fv ) ) { n_cells = 0; coeffs.clear(); return false; }
+      setup( n, fv );
+      max_err = check();
+      if ( max_err <= tol ) return true;
+      if ( n >= max_cells ) return false;
+      // the error decreases as h^4, estimate the needed refinement
+      double ratio = double(max_err/tol);
+      double grow  = ratio < 1e16 ? 1.2*sqrt(sqrt(ratio)) : 1e4;
+      if ( grow < 2 ) grow = 2;
+      n = double(n)*grow < double(max_cells) ? int(n*grow) : max_cells;
+    }
+  }
+
+  /*!
+   * Approximation of an expensive smooth binary function on a
+   * rectangle `[ax,bx]x[ay,by]` by tensor product cubic interpolation
+   * on a uniform grid, with the same error control of Tabulated1.
+   */
+  template <typename T_type = double>
+  class Tabulated2 : public Binary_function<T_type> {
+
+  public:
+
+    typedef T_type                 value_type;
+    typedef value_type*            pointer;
+    typedef const value_type*      const_pointer;
+    typedef value_type (*Func2)(value_type,value_type);
+
+  private:
+
+    Func2              fun;
+    value_type         ax, bx, ay, by, hx, hy, max_err;
+    int                nx, ny;
+    vector<value_type> f; // (nx+1)*(ny+1) samples, x fastest
+
+    // first node of the 4 points stencil and the Lagrange weights
+    static
+    int
+    stencil( value_type s, int n, value_type w[4] ) {
+      int i = int(s);
+      if ( i >= n ) i = n-1;
+      int j = i-1;
+      if ( j < 0 )   j = 0;
+      if ( j > n-3 ) j = n-3;
+      value_type u = s - j;
+      w[0] = -(u-1)*(u-2)*(u-3)/6;
+      w[1] = u*(u-2)*(u-3)/2;
+      w[2] = -u*(u-1)*(u-3)/2;
+      w[3] = u*(u-1)*(u-2)/6;
+      return j;
+    }
+
+    value_type
+    interpolate( value_type x, value_type y ) const {
+      value_type wx[4], wy[4];
+      int i = stencil( (x-ax)/hx, nx, wx );
+      int j = stencil( (y-ay)/hy, ny, wy );
+      value_type res = 0;
+      for ( int l = 0; l < 4; ++l ) {
+        const_pointer row = &f[size_t(j+l)*(nx+1)+i];
+        res += wy[l]*(wx[0]*row[0]+wx[1]*row[1]+wx[2]*row[2]+wx[3]*row[3]);
+      }
+      return res;
+    }
+
+    Tabulated2( Tabulated2 const & );
+    Tabulated2 const & operator = ( Tabulated2 const & );
+
+  public:
+
+    Tabulated2()
+    : fun(0), ax(0), bx(0), ay(0), by(0), hx(0), hy(0), max_err(0)
+    , nx(0), ny(0), f()
+    {}
+
+    /*!
+     *  Build the table
+     *  \param func      the exact function
+     *  \param ax0       left extreme of the `x` interval
+     *  \param bx0       right extreme of the `x` interval
+     *  \param ay0       left extreme of the `y` interval
+     *  \param by0       right extreme of the `y` interval
+     *  \param tol       required tolerance
+     *  \param max_nodes maximum number of nodes of the grid
+     *  \return true if the tolerance is reached
+     */
+    bool
+    build(
+      Func2      func,
+      value_type ax0,
+      value_type bx0,
+      value_type ay0,
+      value_type by0,
+      value_type tol,
+      int        max_nodes = 1<<22
+    );
+
+    //! \return the maximum error measured when building
+    value_type error_estimate() const { return max_err; }
+
+    //! \return the number of nodes of the grid
+    int nodes() const { return nx > 0 ? (nx+1)*(ny+1) : 0; }
+
+    //! \return the exact value of the function
+    value_type exact( value_type x, value_type y ) const { return fun(x,y); }
+
+    value_type
+    eval( value_type x, value_type y ) {
+      if ( !( x >= ax && x <= bx && y >= ay && y <= by ) || nx == 0 )
+        return fun(x,y);
+      return interpolate(x,y);
+    }
+
+    void
+    eval( int n, const_pointer x, const_pointer y, pointer z )
+    { for ( int i = 0; i < n; ++i ) z[i] = eval(x[i],y[i]); }
+
+  };
+
+  template <typename T_type>
+  bool
+  Tabulated2<T_type>::build(
+    Func2      func,
+    value_type ax0,
+    value_type bx0,
+    value_type ay0,
+    value_type by0,
+    value_type tol,
+    int        max_nodes
+  ) {
+    fun = func;
+    ax  = ax0; bx = bx0;
+    ay  = ay0; by = by0;
+    nx  = ny = 0;
+    f.clear();
+    if ( !( bx > ax && by > ay ) || max_nodes < 16 ) return false;
+
+    int mx = 8, my = 8;
+    for (;;) {
+      hx = (bx-ax)/mx;
+      hy = (by-ay)/my;
+      f.resize( size_t(mx+1)*(my+1) );
+      for ( int j = 0; j <= my; ++j ) {
+        value_type y = j < my ? ay + j*hy : by;
+        for ( int i = 0; i <= mx; ++i ) {
+          value_type v = fun( i < mx ? ax + i*hx : bx, y );
+          if ( !( v - v == 0 ) ) { f.clear(); return false; }
+          f[size_t(j)*(mx+1)+i] = v;
+        }
+      }
+      nx = mx; ny = my;
+
+      // check at the center and at the middle of two sides of each cell
+      max_err = 0;
+      for ( int j = 0; j < ny; ++j ) {
+        for ( int i = 0; i < nx; ++i ) {
+          value_type const px[3] = { 0.5, 0.5, 0 }, py[3] = { 0.5, 0, 0.5 };
+          for ( int k = 0; k < 3; ++k ) {
+            value_type x  = ax + (i+px[k])*hx;
+            value_type y  = ay + (j+py[k])*hy;
+            value_type fe = fun(x,y);
+            value_type e  = interpolate(x,y) - fe;
+            value_type s  = fe > 0 ? fe : -fe;
+            if ( e < 0 ) e = -e;
+            if ( s > 1 ) e /= s;
+            if ( !( e <= max_err ) ) max_err = e;
+          }
+        }
+      }
+      if ( max_err <= tol ) return true;
+
+      double ratio = double(max_err/tol);
+      double grow  = ratio < 1e16 ? 1.2*sqrt(sqrt(ratio)) : 1e4;
+      if ( grow < 2 ) grow = 2;
+      double nn = (mx*grow+1)*(my*grow+1);
+      if ( (mx+1)*(my+1) >= max_nodes ) return false;
+      if ( nn > max_nodes ) grow = sqrt( double(max_nodes)/((mx+1)*(my+1)) );
+      if ( int(mx*grow) == mx || int(my*grow) == my ) return false;
+      mx = int(mx*grow);
+      my = int(my*grow);
+    }
+  }
+
+  // end class Tabulated1, Tabulated2
+
+} // end namespace
+
+namespace calc_load {
+  using calc_defs::Tabulated1;
+  using calc_defs::Tabulated2;
+}
+
+#endif
+
+// end of file: calc_tabulate.hh
@@ -0,0 +1,778 @@
+/*--------------------------------------------------------------------------*\
+ |                                                                          |
+ |  This program is free software; you can redistribute it and/or modify    |
+ |  it under the terms of the GNU General Public License as published by    |
+ |  the Free Software Foundation; either version 2, or (at your option)     |
+ |  any later version.                                                      |
+ |                                                                          |
+ |  This program is distributed in the hope that it will be useful,         |
+ |  but WITHOUT ANY WARRANTY; without even the implied warranty of          |
+ |  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           |
+ |  GNU General Public License for more details.                            |
+ |                                                                          |
+ |  You should have received a copy of the GNU General Public License       |
+ |  along with this program; if not, write to the Free Software             |
+ |  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.               |
+ |                                                                          |
+ |  Copyright (C) 1999                                                      |
+ |                                                                          |
+ |            ___    ____  ___  __  __        ___    ____  ___  __  __      |
+ |           /   \  /     /   \  \  /        /   \  /     /   \  \  /       |
+ |          /____/ /__   /____/   \/        /____/ /__   /____/   \/        |
+ |         /   \  /     /   \     /        /   \  /     /   \     /         |
+ |        /____/ /____ /    /    /        /____/ /____ /    /    /          |
+ |                                                                          |
+ |      Enrico Bertolazzi                                                   |
+ |      Dipartimento di Ingegneria Meccanica e Strutturale                  |
+ |      Universita` degli Studi di Trento                                   |
+ |      Via Mesiano 77, I-38050 Trento, Italy                               |
+ |                                                                          |
+\*--------------------------------------------------------------------------*/
+
+
+#ifndef CALC_WATCH_HH
+#define CALC_WATCH_HH
+
+#include "calc.hh"
+#include "calc_store.hh"
+
+// requires C++11 for the thread support
+#include <vector>
+#include <set>
+#include <map>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cerrno>
+
+#include <sys/stat.h>
+#ifdef __linux__
+  #include <sys/inotify.h>
+  #include <poll.h>
+  #include <unistd.h>
+#endif
+
+namespace calc_defs {
+
+  using namespace ::std;
+
+  /*!
+   * Incremental evaluation of a parameter deck, that is a file read
+   * by `Calculator::parse_file`, with the variables assigned by the
+   * deck published in a `Variable_store`.
+   *
+   * The statements (separated by new lines or `;`, comments removed)
+   * are evaluated in order starting from the variables and functions
+   * of a base evaluator.  On `update` the new statements are matched
+   * with the previous ones by a diff, then only the inserted
+   * statements and the ones reading a variable whose value changed
+   * are evaluated again.  The names with `@` are resolved with the
+   * value of the index at the statement, so `i=i+1; K@i=0` works as
+   * in `parse_file`, and the assignments nested in an expression,
+   * like `x = (y = 2) + 1`, are recorded too.  Unlike `parse_file`
+   * an error stops only the statement, not the rest of the line.
+   * The changes of the variables are published at once in a new
+   * version of the store.
+   */
+  template <typename T_type = double>
+  class Deck {
+
+  public:
+
+    typedef T_type                         value_type;
+    typedef Calculator<value_type>         CALCULATOR;
+    typedef Variable_store<value_type>     STORE;
+    typedef typename CALCULATOR::map_real  map_real;
+
+  private:
+
+    typedef struct {
+      string         text;      // statement without comments and blanks
+      unsigned long  line;      // line of the statement in the deck
+      size_t         pos;       // position of the statement in the deck
+      vector<string> reads;     // names read by the last evaluation
+      map_real       writes;    // variables assigned by the last evaluation
+      bool           fresh;     // never evaluated
+    } Stmt;
+
+    typedef pair<string,unsigned long> Source;
+
+    CALCULATOR const & base;
+    STORE &            store;
+    string             file_name;
+    CALCULATOR         ee;
+    map_real           scope; // values read by the evaluated statement
+    vector<Stmt*>      stmts;
+    // statements assigning a name, ordered by position
+    map<string,vector<Stmt*> > writers;
+    // values published in the store
+    map_real           published;
+    size_t             n_evaluated;
+    size_t             max_diff;
+
+    Deck( Deck const & );
+    Deck const & operator = ( Deck const & );
+
+    static bool
+    same( value_type const & a, value_type const & b )
+    { return a == b || ( a != a && b != b ); }
+
+    static void split( string const & text, vector<Source> & src );
+
+    bool
+    diff(
+      vector<Source> const &     src,
+      size_t                     p,
+      size_t                     old_end,
+      size_t                     new_end,
+      vector<pair<size_t,size_t> > & match
+    ) const;
+
+    // value of `name` assigned by the last statement before `pos`
+    bool writer_before( string const & name, size_t pos, value_type & val ) const;
+
+    void writer_insert( Stmt * s );
+    void writer_remove( Stmt * s );
+
+    void   provide( string const & name, Stmt * s );
+    string resolve( string const & name, Stmt * s );
+    bool   evaluate( Stmt * s );
+
+  public:
+
+    /*!
+     *  \param _base  evaluator with the functions and the variables
+     *                visible to the deck (not copied, must outlive
+     *                the deck and not be modified)
+     *  \param _store store where the variables are published
+     *  \param _name  name of the file of the deck
+     */
+    Deck( CALCULATOR const & _base, STORE & _store, string const & _name = "" );
+    ~Deck();
+
+    //! name of the file of the deck
+    string const & name() const { return file_name; }
+
+    //! number of statements
+    size_t size() const { return stmts . size(); }
+
+    //! number of statements evaluated by the last update
+    size_t evaluated() const { return n_evaluated; }
+
+    //! values of the variables assigned by the deck
+    map_real const & variables() const { return published; }
+
+    /*!
+     *  Limit the cost of the diff: when more than `d` statements are
+     *  inserted or removed the differing part is evaluated again.
+     */
+    void set_max_diff( size_t d ) { max_diff = d; }
+
+    /*!
+     *  Replace the content of the deck and publish the variables whose
+     *  value changed (added, modified or no longer assigned).
+     *  \param text     the new content
+     *  \param changed  the names of the changed variables, sorted
+     *  \param show_err if true the evaluation errors are printed
+     *  \param stream_error stream for the errors
+     *  \return the number of evaluation errors
+     */
+    size_t
+    update(
+      string const &   text,
+      vector<string> & changed,
+      bool             show_err = false,
+      ostream &        stream_error = cerr
+    );
+
+    /*!
+     *  Read again the file of the deck and update it.
+     *  \return false if the file cannot be read
+     */
+    bool
+    reload(
+      vector<string> & changed,
+      bool             show_err = false,
+      ostream &        stream_error = cerr
+    );
+
+  };
+
+  template <typename T_type>
+  Deck<T_type>::Deck(
+    CALCULATOR const & _base,
+    STORE &            _store,
+    string const &     _name
+  )
+  : base(_base)
+  , store(_store)
+  , file_name(_name)
+  , ee()
+  , scope()
+  , stmts()
+  , writers()
+  , published()
+  , n_evaluated(0)
+  , max_diff(500) {
+    ee . symbols_merge( base );
+    ee . variables . clear();
+    ee . variables_attach( &scope );
+  }
+
+  template <typename T_type>
+  Deck<T_type>::~Deck() {
+    for ( size_t i = 0; i < stmts . size(); ++i ) delete stmts[i];
+  }
+
+  template <typename T_type>
+  void
+  Deck<T_type>::split( string const & text, vector<Source> & src ) {
+    src . clear();
+    unsigned long line  = 1;
+    size_t        begin = 0;
+    bool          comment = false;
+    for ( size_t i = 0; i <= text . size(); ++i ) {
+      char c = i < text . size() ? text[i] : '\n';
+      if ( c == '\n' || c == ';' || ( c == '#' && !comment ) ) {
+        if ( !comment ) {
+          size_t b = begin, e = i;
+          while ( b < e && isspace(text[b]) ) ++b;
+          while ( e > b && isspace(text[e-1]) ) --e;
+          if ( b < e ) src . push_back( Source( text . substr(b,e-b), line ) );
+        }
+        if ( c == '#' ) comment = true;
+        if ( c == '\n' ) { comment = false; ++line; }
+        begin = i+1;
+      }
+    }
+  }
+
+  // Myers' O(ND) diff of the statements [p,old_end) and [p,new_end)
+  template <typename T_type>
+  bool
+  Deck<T_type>::diff(
+    vector<Source> const &         src,
+    size_t                         p,
+    size_t                         old_end,
+    size_t                         new_end,
+    vector<pair<size_t,size_t> > & match
+  ) const {
+    long n = long(old_end-p), m = long(new_end-p);
+    long max_d = min( n+m, long(max_diff) );
+    long off   = max_d+1;
+    vector<long>           v( 2*max_d+3, 0 );
+    vector<vector<long> >  trace;
+    long d = 0;
+    for ( bool found = false; !found; ++d ) {
+      if ( d > max_d ) return false;
+      // only the diagonals [-d,d] are needed to backtrack the step d
+      trace . push_back( vector<long>( v . begin()+(off-d), v . begin()+(off+d+1) ) );
+      for ( long k = -d; k <= d; k += 2 ) {
+        long x = ( k == -d || ( k != d && v[off+k-1] < v[off+k+1] ) ) ?
+                 v[off+k+1] : v[off+k-1]+1;
+        long y = x-k;
+        while ( x < n && y < m && stmts[p+x] -> text == src[p+y] . first ) { ++x; ++y; }
+        v[off+k] = x;
+        if ( x >= n && y >= m ) { found = true; break; }
+      }
+    }
+    // backtrack the edit path
+    match . clear();
+    long x = n, y = m;
+    for ( d = d-1; d >= 0; --d ) {
+      long const * vd = &trace[d][d]; // diagonal 0
+      long k  = x-y;
+      long pk = ( k == -d || ( k != d && vd[k-1] < vd[k+1] ) ) ? k+1 : k-1;
+      long px = d > 0 ? vd[pk] : 0, py = px-pk;
+      while ( x > px && y > py ) { --x; --y; match . push_back( make_pair(p+x,p+y) ); }
+      x = px; y = py;
+    }
+    reverse( match . begin(), match . end() );
+    return true;
+  }
+
+  template <typename T_type>
+  bool
+  Deck<T_type>::writer_before(
+    string const & name,
+    size_t         pos,
+    value_type &   val
+  ) const {
+    typename map<string,vector<Stmt*> >::const_iterator iw = writers . find(name);
+    if ( iw == writers . end() ) return false;
+    vector<Stmt*> const & w = iw -> second;
+    size_t lo = 0, hi = w . size(); // first writer at or after pos
+    while ( lo < hi ) {
+      size_t mid = (lo+hi)/2;
+      if ( w[mid] -> pos < pos ) lo = mid+1; else hi = mid;
+    }
+    if ( lo == 0 ) return false;
+    val = w[lo-1] -> writes . find(name) -> second;
+    return true;
+  }
+
+  template <typename T_type>
+  void
+  Deck<T_type>::writer_insert( Stmt * s ) {
+    for ( typename map_real::const_iterator iv = s -> writes . begin();
+          iv != s -> writes . end(); ++iv ) {
+      vector<Stmt*> & w = writers[iv -> first];
+      typename vector<Stmt*>::iterator it = w . end();
+      while ( it != w . begin() && (*(it-1)) -> pos > s -> pos ) --it;
+      w . insert( it, s );
+    }
+  }
+
+  template <typename T_type>
+  void
+  Deck<T_type>::writer_remove( Stmt * s ) {
+    for ( typename map_real::const_iterator iv = s -> writes . begin();
+          iv != s -> writes . end(); ++iv ) {
+      typename map<string,vector<Stmt*> >::iterator iw = writers . find(iv -> first);
+      if ( iw == writers . end() ) continue;
+      vector<Stmt*> & w = iw -> second;
+      w . erase( std::remove( w . begin(), w . end(), s ), w . end() );
+      if ( w . empty() ) writers . erase( iw );
+    }
+  }
+
+  // record a name read by the statement and give it its value at the statement
+  template <typename T_type>
+  void
+  Deck<T_type>::provide( string const & name, Stmt * s ) {
+    s -> reads . push_back( name );
+    value_type val;
+    if ( writer_before( name, s -> pos, val ) ) {
+      scope[name] = val;
+    } else {
+      if ( base . lookup( name, val ) ) scope[name] = val;
+    }
+  }
+
+  // the name of a variable `a@i`, empty if the index is unknown
+  template <typename T_type>
+  string
+  Deck<T_type>::resolve( string const & name, Stmt * s ) {
+    size_t at = name . find('@');
+    if ( at == string::npos ) return name;
+    string     var2 = name . substr(at+1);
+    value_type idx;
+    provide( var2, s );
+    if ( !ee . lookup( var2, idx ) ) return "";
+    ee . to_string( idx, var2 );
+    return name . substr(0,at) + var2;
+  }
+
+  template <typename T_type>
+  bool
+  Deck<T_type>::evaluate( Stmt * s ) {
+    // collect the names read, giving them the values at the statement;
+    // the names assigned are not read (a name both read and assigned
+    // is a read)
+    scope . clear();
+    ee . variables . clear();
+    s -> reads . clear();
+    ee . string_in = ee . ptr = s -> text . c_str();
+    ee . Next_Token();
+    while ( ee . token_type != CALCULATOR::EndOfString &&
+            ee . token_type != CALCULATOR::EndOfExpression ) {
+      if ( ee . token_type != CALCULATOR::Variable ) {
+        ee . Next_Token();
+        continue;
+      }
+      string name = ee . token_string;
+      ee . Next_Token();
+      if ( ee . token_type == CALCULATOR::OpenPar ) continue; // a function
+      name = resolve( name, s );
+      if ( ee . token_type != CALCULATOR::Assign && !name . empty() )
+        provide( name, s );
+    }
+    // the local variables of the evaluator are the ones assigned,
+    // also by the part of a statement evaluated before an error
+    bool error = ee . parse( s -> text );
+    s -> writes . swap( ee . variables );
+    ee . variables . clear();
+    return !error;
+  }
+
+  template <typename T_type>
+  size_t
+  Deck<T_type>::update(
+    string const &   text,
+    vector<string> & changed,
+    bool             show_err,
+    ostream &        stream_error
+  ) {
+    changed . clear();
+    n_evaluated = 0;
+
+    vector<Source> src;
+    split( text, src );
+
+    // statements equal at the beginning and at the end
+    size_t n_old = stmts . size(), n_new = src . size();
+    size_t p = 0, q = 0;
+    while ( p < n_old && p < n_new && stmts[p] -> text == src[p] . first ) ++p;
+    while ( q < n_old-p && q < n_new-p &&
+            stmts[n_old-1-q] -> text == src[n_new-1-q] . first ) ++q;
+
+    vector<pair<size_t,size_t> > match;
+    if ( !diff( src, p, n_old-q, n_new-q, match ) ) match . clear();
+    match . push_back( make_pair(n_old-q,n_new-q) ); // sentinel
+
+    // splice: keep the matched statements, remove or add the others
+    vector<Stmt*>                  next( stmts . begin(), stmts . begin()+p );
+    vector<pair<size_t,string> >   removed; // position and name assigned
+    size_t i = p, first = n_new, last = 0;
+    for ( size_t m = 0; m < match . size(); ++m ) {
+      for ( ; i < match[m] . first; ++i ) {
+        Stmt * s = stmts[i];
+        writer_remove( s );
+        for ( typename map_real::const_iterator iv = s -> writes . begin();
+              iv != s -> writes . end(); ++iv ) {
+          removed . push_back( make_pair( next . size(), iv -> first ) );
+          first = min( first, next . size() );
+        }
+        delete s;
+      }
+      for ( size_t j = next . size(); j < match[m] . second; ++j ) {
+        Stmt * s = new Stmt();
+        s -> text  = src[j] . first;
+        s -> fresh = true;
+        first = min( first, j );
+        last  = j+1;
+        next . push_back( s );
+      }
+      if ( m+1 < match . size() ) next . push_back( stmts[i++] );
+    }
+    next . insert( next . end(), stmts . begin()+(n_old-q), stmts . end() );
+    stmts . swap( next );
+    for ( size_t j = 0; j < stmts . size(); ++j ) {
+      stmts[j] -> pos  = j;
+      stmts[j] -> line = src[j] . second;
+    }
+
+    // evaluate in order the statements whose input changed, `dirty` holds
+    // the names whose value at the current statement may differ
+    set<string> dirty;
+    size_t      n_errors = 0, ir = 0;
+    for ( size_t j = first; j < stmts . size(); ++j ) {
+      for ( ; ir < removed . size() && removed[ir] . first == j; ++ir )
+        dirty . insert( removed[ir] . second );
+      if ( dirty . empty() && j >= last && ir == removed . size() ) break;
+
+      Stmt * s    = stmts[j];
+      bool   redo = s -> fresh;
+      for ( size_t k = 0; k < s -> reads . size() && !redo; ++k )
+        redo = dirty . count( s -> reads[k] ) > 0;
+      if ( !redo ) {
+        // same values as before
+        for ( typename map_real::const_iterator iv = s -> writes . begin();
+              iv != s -> writes . end(); ++iv )
+          dirty . erase( iv -> first );
+        continue;
+      }
+
+      writer_remove( s );
+      map_real old_writes;
+      old_writes . swap( s -> writes );
+      ++n_evaluated;
+      if ( !evaluate( s ) ) {
+        ++n_errors;
+        if ( show_err ) {
+          stream_error << "in file '" << file_name
+                       << "' on line " << s -> line
+                       << " found an error\n";
+          ee . report_error( stream_error );
+        }
+      }
+      writer_insert( s );
+
+      // a name assigned the same value as before is no longer dirty
+      for ( typename map_real::const_iterator iv = s -> writes . begin();
+            iv != s -> writes . end(); ++iv ) {
+        typename map_real::const_iterator io = old_writes . find( iv -> first );
+        if ( !s -> fresh && io != old_writes . end() && same( io -> second, iv -> second ) )
+          dirty . erase( iv -> first );
+        else
+          dirty . insert( iv -> first );
+      }
+      for ( typename map_real::const_iterator io = old_writes . begin();
+            io != old_writes . end(); ++io )
+        if ( s -> writes . count( io -> first ) == 0 ) dirty . insert( io -> first );
+      s -> fresh = false;
+    }
+    for ( ; ir < removed . size(); ++ir ) dirty . insert( removed[ir] . second );
+
+    // publish the final values that differ
+    map_real set_vars;
+    for ( set<string>::const_iterator id = dirty . begin(); id != dirty . end(); ++id ) {
+      typename map<string,vector<Stmt*> >::const_iterator iw = writers . find(*id);
+      typename map_real::iterator ip = published . find(*id);
+      if ( iw != writers . end() ) {
+        value_type v = iw -> second . back() -> writes . find(*id) -> second;
+        if ( ip != published . end() && same( ip -> second, v ) ) continue;
+        published[*id] = set_vars[*id] = v;
+      } else {
+        if ( ip == published . end() ) continue;
+        published . erase( ip );
+      }
+      changed . push_back( *id );
+    }
+    if ( !changed . empty() ) {
+      store . update( [&]( map_real & vars ) {
+        for ( size_t k = 0; k < changed . size(); ++k ) {
+          typename map_real::const_iterator is = set_vars . find( changed[k] );
+          if ( is != set_vars . end() ) vars[is -> first] = is -> second;
+          else                          vars . erase( changed[k] );
+        }
+      } );
+    }
+    return n_errors;
+  }
+
+  template <typename T_type>
+  bool
+  Deck<T_type>::reload(
+    vector<string> & changed,
+    bool             show_err,
+    ostream &        stream_error
+  ) {
+    changed . clear();
+    ifstream stream( file_name . c_str() );
+    if ( !stream . is_open() ) {
+      if ( show_err )
+        stream_error << "ERROR in opening file '" << file_name << "'\n";
+      return false;
+    }
+    stringstream text;
+    text << stream . rdbuf();
+    update( text . str(), changed, show_err, stream_error );
+    return true;
+  }
+
+  // end class Deck
+
+  /*!
+   * Watches a set of deck files and reloads them when they are
+   * written.  On Linux the directories of the files are watched with
+   * inotify (so files replaced by a rename are detected), elsewhere,
+   * or if inotify is not available, the modification time and the
+   * size of the files are checked at each poll.
+   *
+   * The decks are independent: each one is evaluated from the base
+   * evaluator only.
+   */
+  template <typename T_type = double>
+  class Deck_watcher {
+
+  public:
+
+    typedef T_type                     value_type;
+    typedef Calculator<value_type>     CALCULATOR;
+    typedef Variable_store<value_type> STORE;
+    typedef Deck<value_type>           DECK;
+
+    //! called after a reload with the names of the changed variables
+    typedef function<void(string const & file, vector<string> const & changed)> Callback;
+
+  private:
+
+    typedef struct {
+      DECK *  deck;
+      string  dir;
+      string  base_name;
+      time_t  mtime;
+      off_t   size;
+    } Entry;
+
+    CALCULATOR const & base;
+    STORE &            store;
+    Callback           callback;
+    bool               show_err;
+    ostream *          stream_error;
+    vector<Entry>      entries;
+    int                fd;  // inotify descriptor, -1 when polling
+    map<int,string>    dirs;
+
+    Deck_watcher( Deck_watcher const & );
+    Deck_watcher const & operator = ( Deck_watcher const & );
+
+    bool changed_on_disk( Entry & e );
+    void reload( Entry & e );
+
+  public:
+
+    /*!
+     *  \param _base  evaluator with the functions and the variables
+     *                visible to the decks
+     *  \param _store store where the variables are published
+     */
+    Deck_watcher( CALCULATOR const & _base, STORE & _store );
+    ~Deck_watcher();
+
+    //! function called after each reload changing some variable
+    void set_callback( Callback const & cb ) { callback = cb; }
+
+    //! print the evaluation errors on `s`
+    void
+    set_show_error( bool show, ostream & s = cerr )
+    { show_err = show; stream_error = &s; }
+
+    //! true if the files are watched with inotify
+    bool notified() const { return fd >= 0; }
+
+    /*!
+     *  Load a deck and watch its file.
+     *  \return false if the file cannot be read
+     */
+    bool watch( string const & file );
+
+    //! the deck of a watched file, null if not watched
+    DECK const * deck( string const & file ) const;
+
+    /*!
+     *  Wait for changes of the files, up to `timeout_ms` milliseconds,
+     *  and reload the changed decks.
+     *  \return the number of reloaded decks
+     */
+    size_t poll( int timeout_ms );
+
+    //! poll until `stop` becomes true
+    void
+    run( atomic<bool> const & stop, int period_ms = 200 )
+    { while ( !stop . load() ) poll( period_ms ); }
+
+  };
+
+  template <typename T_type>
+  Deck_watcher<T_type>::Deck_watcher( CALCULATOR const & _base, STORE & _store )
+  : base(_base)
+  , store(_store)
+  , callback()
+  , show_err(false)
+  , stream_error(&cerr)
+  , entries()
+  , fd(-1)
+  , dirs() {
+    #ifdef __linux__
+    fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    #endif
+  }
+
+  template <typename T_type>
+  Deck_watcher<T_type>::~Deck_watcher() {
+    for ( size_t i = 0; i < entries . size(); ++i ) delete entries[i] . deck;
+    #ifdef __linux__
+    if ( fd >= 0 ) close( fd );
+    #endif
+  }
+
+  template <typename T_type>
+  bool
+  Deck_watcher<T_type>::changed_on_disk( Entry & e ) {
+    struct stat st;
+    if ( stat( e . deck -> name() . c_str(), &st ) != 0 ) return false;
+    if ( st . st_mtime == e . mtime && st . st_size == e . size ) return false;
+    e . mtime = st . st_mtime;
+    e . size  = st . st_size;
+    return true;
+  }
+
+  template <typename T_type>
+  void
+  Deck_watcher<T_type>::reload( Entry & e ) {
+    vector<string> changed;
+    if ( e . deck -> reload( changed, show_err, *stream_error ) &&
+         !changed . empty() && callback )
+      callback( e . deck -> name(), changed );
+  }
+
+  template <typename T_type>
+  bool
+  Deck_watcher<T_type>::watch( string const & file ) {
+    Entry e;
+    size_t slash = file . find_last_of('/');
+    e . dir       = slash == string::npos ? "." : file . substr(0,slash+1);
+    e . base_name = slash == string::npos ? file : file . substr(slash+1);
+    e . mtime     = 0;
+    e . size      = 0;
+    e . deck      = new DECK( base, store, file );
+    changed_on_disk( e );
+    vector<string> changed;
+    if ( !e . deck -> reload( changed, show_err, *stream_error ) ) {
+      delete e . deck;
+      return false;
+    }
+    #ifdef __linux__
+    if ( fd >= 0 ) {
+      int wd = inotify_add_watch( fd, e . dir . c_str(), IN_CLOSE_WRITE | IN_MOVED_TO );
+      if ( wd >= 0 ) dirs[wd] = e . dir;
+    }
+    #endif
+    entries . push_back( e );
+    if ( !changed . empty() && callback ) callback( file, changed );
+    return true;
+  }
+
+  template <typename T_type>
+  typename Deck_watcher<T_type>::DECK const *
+  Deck_watcher<T_type>::deck( string const & file ) const {
+    for ( size_t i = 0; i < entries . size(); ++i )
+      if ( entries[i] . deck -> name() == file ) return entries[i] . deck;
+    return nullptr;
+  }
+
+  template <typename T_type>
+  size_t
+  Deck_watcher<T_type>::poll( int timeout_ms ) {
+    vector<bool> dirty( entries . size(), false );
+    #ifdef __linux__
+    if ( fd >= 0 ) {
+      struct pollfd pfd;
+      pfd . fd     = fd;
+      pfd . events = POLLIN;
+      if ( ::poll( &pfd, 1, timeout_ms ) > 0 ) {
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t len;
+        while ( (len = read( fd, buffer, sizeof(buffer) )) > 0 ) {
+          for ( char * ptr = buffer; ptr < buffer+len; ) {
+            struct inotify_event const * ev = (struct inotify_event const *) ptr;
+            ptr += sizeof(struct inotify_event) + ev -> len;
+            map<int,string>::const_iterator id = dirs . find( ev -> wd );
+            for ( size_t i = 0; i < entries . size(); ++i ) {
+              if ( (ev -> mask & IN_Q_OVERFLOW) != 0 ) { dirty[i] = true; continue; }
+              if ( id != dirs . end() && ev -> len > 0 &&
+                   entries[i] . dir == id -> second &&
+                   entries[i] . base_name == ev -> name ) dirty[i] = true;
+            }
+          }
+        }
+      }
+      size_t n = 0;
+      for ( size_t i = 0; i < entries . size(); ++i )
+        if ( dirty[i] ) { changed_on_disk( entries[i] ); reload( entries[i] ); ++n; }
+      return n;
+    }
+    #endif
+    this_thread::sleep_for( chrono::milliseconds( timeout_ms ) );
+    size_t n = 0;
+    for ( size_t i = 0; i < entries . size(); ++i )
+      if ( changed_on_disk( entries[i] ) ) { reload( entries[i] ); ++n; }
+    return n;
+  }
+
+  // end class Deck_watcher
+
+} // end namespace
+
+namespace calc_load {
+  using calc_defs::Deck;
+  using calc_defs::Deck_watcher;
+}
+
+#endif
+
+// end of file: calc_watch.hh
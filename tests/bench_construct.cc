@@ -0,0 +1,57 @@
+
+# include "calc.hh"
+
+# include <ctime>
+
+using namespace calc_load;
+
+using std::cout;
+using std::endl;
+
+typedef Calculator<double> CALC;
+
+static
+double
+elapsed_ns( clock_t t0, clock_t t1, long n ) {
+  return 1e9*double(t1-t0)/double(CLOCKS_PER_SEC)/double(n);
+}
+
+int
+main() {
+
+  long const n = 2000000;
+  double     sum = 0;
+  clock_t    t0, t1;
+
+  // construction only
+  t0 = clock();
+  for ( long i = 0; i < n; ++i ) {
+    CALC ee;
+    sum += ee.get_value();
+  }
+  t1 = clock();
+  cout << "construct           " << elapsed_ns(t0,t1,n) << " ns/instance\n";
+
+  // construction + a short evaluation using builtins
+  t0 = clock();
+  for ( long i = 0; i < n/10; ++i ) {
+    CALC ee;
+    ee.parse("sin(pi/4)*exp(1)+max(e,2)");
+    sum += ee.get_value();
+  }
+  t1 = clock();
+  cout << "construct + parse   " << elapsed_ns(t0,t1,n/10) << " ns/instance\n";
+
+  // evaluation only, same instance
+  CALC ee;
+  t0 = clock();
+  for ( long i = 0; i < n/10; ++i ) {
+    ee.parse("sin(pi/4)*exp(1)+max(e,2)");
+    sum += ee.get_value();
+  }
+  t1 = clock();
+  cout << "parse               " << elapsed_ns(t0,t1,n/10) << " ns/expression\n";
+
+  cout << "checksum " << sum << endl;
+  return 0;
+}
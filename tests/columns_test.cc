@@ -0,0 +1,85 @@
+
+# include "calc_columns.hh"
+
+# include <cmath>
+
+using namespace calc_load;
+
+using std::string;
+using std::vector;
+using std::cout;
+using std::endl;
+
+typedef Calculator<double> CALC;
+typedef Columns<double>    COLUMNS;
+
+static int n_errors = 0;
+
+static
+void
+check( bool ok, string const & what ) {
+  if ( !ok ) { cout << "FAILED: " << what << endl; ++n_errors; }
+}
+
+int
+main() {
+
+  CALC ee;
+  ee.set("scale", 10);
+
+  COLUMNS        cols;
+  vector<string> names, outputs;
+  string const   csv =
+    "x, y\n"
+    "1,2\n"
+    "3,0\r\n"
+    "\n"
+    "-4.5e1 ,6\n"
+    "abc,1\n"
+    "7";
+
+  char const * body = cols.csv_header( csv.data(), csv.data()+csv.size(), names );
+  check( names.size() == 2 && names[0] == "x" && names[1] == "y", "header" );
+  check( !cols.compile( ee, "r = x*scale; q = x/y", names, vector<string>(1,"w") ) &&
+         cols.missing() == "w", "missing output" );
+  check( cols.compile( ee, "r = x*scale; q = x/y", names, outputs ), "compile" );
+  check( cols.outputs().size() == 2 && cols.outputs()[1] == "q", "outputs" );
+
+  // chunks of whole lines
+  char const * end = csv.data()+csv.size();
+  char const * e1  = COLUMNS::chunk_end( body, end, 3 );
+  check( e1 == body+4, "chunk end at a new line" );
+  check( COLUMNS::chunk_end( body, end, 1000 ) == end, "last chunk" );
+
+  COLUMNS::Buffer buf;
+  string          out;
+  size_t          n_err = 0;
+  cols.set_digits(6);
+  cols.csv_header(out);
+  size_t n = cols.csv_chunk( body, e1, out, buf, n_err );
+  n += cols.csv_chunk( e1, end, out, buf, n_err );
+  check( n == 5, "rows" );
+  check( n_err == 1, "division by zero" );
+  check( out ==
+         "r,q\n"
+         "10,0.5\n"
+         "nan,nan\n"
+         "-450,-7.5\n"
+         "nan,nan\n"
+         "70,nan\n", "output:\n" + out );
+
+  // inputs kept and evaluation of columns in place
+  cols.set_keep_inputs(true);
+  check( cols.compile( ee, "r = x*scale; q = x/y", names, vector<string>(1,"q") ), "select" );
+  double x[] = { 1, 2, 3 }, y[] = { 4, 5, 6 };
+  double const * in[] = { x, y };
+  check( cols.eval( 3, in, buf ) == 0 && buf.out.size() == 1 &&
+         buf.out[0][2] == 0.5, "eval" );
+  out.clear();
+  cols.csv_header(out);
+  cols.csv_format( 1, buf, out );
+  check( out == "x,y,q\n1,4,0.25\n", "keep inputs:\n" + out );
+
+  if ( n_errors == 0 ) cout << "columns_test: all tests passed" << endl;
+  return n_errors == 0 ? 0 : 1;
+}
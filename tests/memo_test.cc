@@ -0,0 +1,104 @@
+
+# include "calc_memo.hh"
+
+# include <ctime>
+
+using namespace calc_load;
+
+using std::cout;
+using std::endl;
+
+typedef Calculator<double> CALC;
+
+static unsigned long ncalls = 0;
+
+// an expensive pure function
+static
+double
+curvature( double const s ) {
+  ++ncalls;
+  double k = 0;
+  for ( int i = 1; i <= 2000; ++i ) k += std::sin(i*s)/(i*i);
+  return k;
+}
+
+static
+double
+width( double const s, double const k ) {
+  ++ncalls;
+  return 6 + s*k;
+}
+
+static
+double
+elapsed( clock_t t0 )
+{ return double(clock()-t0)/CLOCKS_PER_SEC; }
+
+int
+main() {
+
+  int nerr = 0;
+
+  // a deck calling the same function with the same arguments
+  char const * deck =
+    "i=1; s=0.5;  K@i = curvature(s); W@i = width(s,curvature(s));"
+    "i=2; s=0.75; K@i = curvature(s); W@i = width(s,curvature(s));"
+    "i=3; s=0.5;  K@i = curvature(s); W@i = width(s,curvature(s));";
+
+  CALC ee, ee_memo;
+  ee.set_unary_fun( "curvature", curvature );
+  ee.set_binary_fun( "width", width );
+
+  Memoized1<double> m_curvature( curvature, 64 );
+  Memoized2<double> m_width( width, 64 );
+  ee_memo.set_unary_fun( "curvature", &m_curvature );
+  ee_memo.set_binary_fun( "width", &m_width );
+
+  ncalls = 0;
+  ee.parse(deck);
+  unsigned long calls_plain = ncalls;
+  ncalls = 0;
+  ee_memo.parse(deck);
+  unsigned long calls_memo = ncalls;
+  cout << "calls: " << calls_plain << " plain, " << calls_memo << " memoized\n";
+  cout << "curvature hits " << m_curvature.hits() << " misses " << m_curvature.misses()
+       << ", width hits " << m_width.hits() << " misses " << m_width.misses() << "\n";
+  if ( calls_memo != 4 || m_curvature.hits() != 4 || m_curvature.misses() != 2 ) ++nerr;
+  if ( m_width.hits() != 1 || m_width.misses() != 2 ) ++nerr;
+
+  bool ok;
+  char const * names[] = { "K1", "K2", "K3", "W1", "W2", "W3" };
+  for ( int i = 0; i < 6; ++i )
+    if ( ee.get(names[i],ok) != ee_memo.get(names[i],ok) ) ++nerr;
+
+  // invalidation
+  m_curvature.clear();
+  m_curvature.reset_statistics();
+  ee_memo.parse( "curvature(0.5)" );
+  if ( m_curvature.misses() != 1 || m_curvature.hits() != 0 ) ++nerr;
+
+  // keys are the bits of the arguments
+  ee_memo.parse( "curvature(0.5)+curvature(0.5000000000000001)" );
+  if ( m_curvature.hits() != 1 || m_curvature.misses() != 2 ) ++nerr;
+
+  // bounded size
+  m_curvature.set_capacity(100);
+  if ( m_curvature.capacity() != 128 ) ++nerr;
+
+  // speed on repeated calls
+  int const n = 100000;
+  m_curvature.reset_statistics();
+  clock_t t0 = clock();
+  double  s1 = 0, s2 = 0;
+  for ( int i = 0; i < n/100; ++i ) s1 += curvature( (i % 10)*0.1 );
+  double t_plain = elapsed(t0)*100;
+  t0 = clock();
+  for ( int i = 0; i < n; ++i ) s2 += m_curvature.eval( (i % 10)*0.1 );
+  double t_memo = elapsed(t0);
+  cout << "per call: plain " << 1e9*t_plain/n << " ns, memoized "
+       << 1e9*t_memo/n << " ns (" << m_curvature.hits() << " hits)\n";
+  if ( std::abs(100*s1-s2) > 1e-6*std::abs(s2) ) ++nerr;
+
+  cout << ( nerr == 0 ? "memo test passed" : "memo test FAILED" ) << endl;
+  return nerr == 0 ? 0 : 1;
+}
@@ -0,0 +1,361 @@
+
+# include "calc_simd.hh"
+# include "calc_batch.hh"
+
+# include <iostream>
+# include <iomanip>
+# include <limits>
+# include <vector>
+# include <ctime>
+
+using namespace calc_defs;
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+typedef double (*Func1)( double );
+typedef double (*Func2)( double, double );
+
+static
+double
+sample( unsigned long long & seed ) {
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return double(seed >> 11) / 9007199254740992.0; // [0,1)
+}
+
+// distance in units in the last place
+static
+double
+ulp_distance( double a, double b ) {
+  if ( a != a && b != b ) return 0; // both NaN
+  if ( a == b ) return 0;
+  if ( a != a || b != b ) return 1e300;
+  long long ia, ib;
+  memcpy( &ia, &a, sizeof(a) );
+  memcpy( &ib, &b, sizeof(b) );
+  if ( ia < 0 ) ia = (long long)(0x8000000000000000ULL) - ia;
+  if ( ib < 0 ) ib = (long long)(0x8000000000000000ULL) - ib;
+  long long d = ia > ib ? ia - ib : ib - ia;
+  return double(d);
+}
+
+typedef struct {
+  char const *  name;
+  simd::Kernel1 vfun;
+  Func1         fun;
+  double        lo, hi;
+  bool          logscale;
+  double        bound; // documented ULP bound
+} Test_case;
+
+static double l_exp   ( double x ) { return std::exp(x);   }
+static double l_log   ( double x ) { return std::log(x);   }
+static double l_log10 ( double x ) { return std::log10(x); }
+static double l_sin   ( double x ) { return std::sin(x);   }
+static double l_cos   ( double x ) { return std::cos(x);   }
+static double l_tan   ( double x ) { return std::tan(x);   }
+static double l_sqrt  ( double x ) { return std::sqrt(x);  }
+static double l_floor ( double x ) { return std::floor(x); }
+static double l_ceil  ( double x ) { return std::ceil(x);  }
+static double l_abs   ( double x ) { return std::fabs(x);  }
+static double l_asin  ( double x ) { return std::asin(x);  }
+static double l_acos  ( double x ) { return std::acos(x);  }
+static double l_atan  ( double x ) { return std::atan(x);  }
+static double l_sinh  ( double x ) { return std::sinh(x);  }
+static double l_cosh  ( double x ) { return std::cosh(x);  }
+static double l_tanh  ( double x ) { return std::tanh(x);  }
+static double l_atan2 ( double y, double x ) { return std::atan2(y,x); }
+static double l_pow   ( double x, double y ) { return std::pow(x,y);   }
+
+int
+main() {
+
+  Test_case const tests[] = {
+    { "exp",   simd::vexp,   l_exp,   -1,     1,      false, 1 },
+    { "exp",   simd::vexp,   l_exp,   -745,   710,    false, 1 },
+    { "log",   simd::vlog,   l_log,   0.5,    2,      false, 1 },
+    { "log",   simd::vlog,   l_log,   1e-310, 1e308,  true,  1 },
+    { "log10", simd::vlog10, l_log10, 0.5,    2,      false, 2 },
+    { "log10", simd::vlog10, l_log10, 1e-310, 1e308,  true,  2 },
+    { "sin",   simd::vsin,   l_sin,   -4,     4,      false, 2 },
+    { "sin",   simd::vsin,   l_sin,   -1e6,   1e6,    false, 2 },
+    { "cos",   simd::vcos,   l_cos,   -4,     4,      false, 2 },
+    { "cos",   simd::vcos,   l_cos,   -1e6,   1e6,    false, 2 },
+    { "tan",   simd::vtan,   l_tan,   -4,     4,      false, 4 },
+    { "tan",   simd::vtan,   l_tan,   -1e6,   1e6,    false, 4 },
+    { "sqrt",  simd::vsqrt,  l_sqrt,  0,      1e10,   false, 0 },
+    { "floor", simd::vfloor, l_floor, -1e3,   1e3,    false, 0 },
+    { "ceil",  simd::vceil,  l_ceil,  -1e3,   1e3,    false, 0 },
+    { "abs",   simd::vabs,   l_abs,   -1e3,   1e3,    false, 0 },
+    { "asin",  simd::vasin,  l_asin,  -1,     1,      false, 1 },
+    { "acos",  simd::vacos,  l_acos,  -1,     1,      false, 1 },
+    { "atan",  simd::vatan,  l_atan,  -4,     4,      false, 1 },
+    { "atan",  simd::vatan,  l_atan,  1e-10,  1e10,   true,  1 },
+    { "sinh",  simd::vsinh,  l_sinh,  -2,     2,      false, 2 },
+    { "sinh",  simd::vsinh,  l_sinh,  -712,   712,    false, 2 },
+    { "cosh",  simd::vcosh,  l_cosh,  -2,     2,      false, 2 },
+    { "cosh",  simd::vcosh,  l_cosh,  -712,   712,    false, 2 },
+    { "tanh",  simd::vtanh,  l_tanh,  -2,     2,      false, 2 },
+    { "tanh",  simd::vtanh,  l_tanh,  -30,    30,     false, 2 }
+  };
+
+  double const special[] = {
+    0.0, -0.0, 1.0, -1.0, 1e-320, -1e-320, 1e-9, -1e-9, 708.0, -708.0,
+    709.7, -745.2, 1e300, -1e300,
+    std::numeric_limits<double>::infinity(),
+    -std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::quiet_NaN()
+  };
+
+  int const      n  = 200003; // not a multiple of the vector width
+  int const      ns = sizeof(special)/sizeof(special[0]);
+  int const      nt = sizeof(tests)/sizeof(tests[0]);
+  vector<double> x(n+ns), y(n+ns), y0(n+ns);
+  int            nerr = 0;
+
+  // results of the first vector level, the other must be identical
+  vector<vector<double> > ref(nt);
+
+  simd::Level const levels[] = { simd::Scalar, simd::SSE2, simd::AVX2 };
+  for ( int l = 0; l < 3; ++l ) {
+    simd::set_level( levels[l] );
+    if ( simd::level() != levels[l] ) continue; // not supported
+    cout << "\nlevel " << levels[l] << "\n";
+
+    for ( int t = 0; t < nt; ++t ) {
+      Test_case const & tc = tests[t];
+      unsigned long long seed = 12345+t;
+      for ( int i = 0; i < n; ++i ) {
+        double s = sample(seed);
+        x[i] = tc.logscale ? std::exp( std::log(tc.lo) + s*(std::log(tc.hi)-std::log(tc.lo)) )
+                           : tc.lo + s*(tc.hi-tc.lo);
+      }
+      for ( int i = 0; i < ns; ++i ) x[n+i] = special[i];
+
+      tc.vfun( n+ns, &x.front(), &y.front() );
+
+      // in place evaluation, as done by Program, must give the same values
+      y0 = x;
+      tc.vfun( n+ns, &y0.front(), &y0.front() );
+      if ( memcmp( &y0.front(), &y.front(), (n+ns)*sizeof(double) ) != 0 ) {
+        cout << tc.name << " in place evaluation differs  FAILED\n";
+        ++nerr;
+      }
+
+      if ( levels[l] != simd::Scalar ) {
+        if ( ref[t].empty() ) {
+          ref[t] = y;
+        } else if ( memcmp( &ref[t].front(), &y.front(), (n+ns)*sizeof(double) ) != 0 ) {
+          cout << tc.name << " results differ between vector levels  FAILED\n";
+          ++nerr;
+        }
+      }
+
+      double maxulp = 0, xmax = 0;
+      for ( int i = 0; i < n+ns; ++i ) {
+        double d = ulp_distance( y[i], tc.fun(x[i]) );
+        if ( d > maxulp ) { maxulp = d; xmax = x[i]; }
+      }
+      bool ok = maxulp <= tc.bound;
+      if ( !ok ) ++nerr;
+      cout << std::setw(6) << tc.name << " [" << tc.lo << "," << tc.hi << "] max "
+           << maxulp << " ULP (bound " << tc.bound << ")";
+      if ( maxulp > 0 ) cout << " at x = " << std::setprecision(17) << xmax << std::setprecision(6);
+      cout << ( ok ? "" : "  FAILED" ) << "\n";
+    }
+  }
+
+  // binary kernels
+  {
+    unsigned long long seed = 777;
+    for ( int i = 0; i < n; ++i ) { x[i] = sample(seed)-0.5; y0[i] = sample(seed)-0.5; }
+    simd::vmax( n, &x.front(), &y0.front(), &y.front() );
+    for ( int i = 0; i < n; ++i ) if ( y[i] != (x[i] > y0[i] ? x[i] : y0[i]) ) { ++nerr; break; }
+    simd::vmin( n, &x.front(), &y0.front(), &y.front() );
+    for ( int i = 0; i < n; ++i ) if ( y[i] != (x[i] < y0[i] ? x[i] : y0[i]) ) { ++nerr; break; }
+  }
+
+  // atan2 and pow: random pairs and all the pairs of special values,
+  // bound, in place evaluation and identity of the vector levels
+  {
+    typedef struct {
+      char const *  name;
+      simd::Kernel2 vfun;
+      Func2         fun;
+      double        xlo, xhi, ylo, yhi;
+      double        bound;
+    } Test_case2;
+    Test_case2 const tests2[] = {
+      { "atan2", simd::vatan2, l_atan2, -10,  10,  -10,   10,   1 },
+      { "atan2", simd::vatan2, l_atan2, -1e6, 1e6, -1e-6, 1e-6, 1 },
+      { "pow",   simd::vpow,   l_pow,   0,    4,   -30,   30,   1 },
+      { "pow",   simd::vpow,   l_pow,   0,    1e6, -50,   50,   1 },
+      { "pow",   simd::vpow,   l_pow,   0.9,  1.1, -5000, 5000, 1 }
+    };
+    double const sp2[] = {
+      0.0, -0.0, 1.0, -1.0, 0.5, -2.0, 3.0, -3.0, 1e-320, 1e300, -1e300, 1e-300,
+      std::numeric_limits<double>::infinity(),
+      -std::numeric_limits<double>::infinity(),
+      std::numeric_limits<double>::quiet_NaN()
+    };
+    int const ns2 = sizeof(sp2)/sizeof(sp2[0]);
+    int const nt2 = sizeof(tests2)/sizeof(tests2[0]);
+    int const m   = n + ns2*ns2;
+    vector<double> a(m), b(m), c(m), c0(m);
+    vector<vector<double> > ref2(nt2);
+    for ( int l = 0; l < 3; ++l ) {
+      simd::set_level( levels[l] );
+      if ( simd::level() != levels[l] ) continue;
+      cout << "\nlevel " << levels[l] << "\n";
+      for ( int t = 0; t < nt2; ++t ) {
+        Test_case2 const & tc = tests2[t];
+        unsigned long long seed = 54321+t;
+        for ( int i = 0; i < n; ++i ) {
+          a[i] = tc.ylo + sample(seed)*(tc.yhi-tc.ylo);
+          b[i] = tc.xlo + sample(seed)*(tc.xhi-tc.xlo);
+          if ( tc.vfun == simd::vpow ) std::swap( a[i], b[i] ); // pow(x,y)
+        }
+        for ( int i = 0; i < ns2*ns2; ++i ) { a[n+i] = sp2[i/ns2]; b[n+i] = sp2[i%ns2]; }
+
+        tc.vfun( m, &a.front(), &b.front(), &c.front() );
+
+        c0 = a;
+        tc.vfun( m, &c0.front(), &b.front(), &c0.front() );
+        bool same = memcmp( &c0.front(), &c.front(), m*sizeof(double) ) == 0;
+        c0 = b;
+        tc.vfun( m, &a.front(), &c0.front(), &c0.front() );
+        same = same && memcmp( &c0.front(), &c.front(), m*sizeof(double) ) == 0;
+        if ( !same ) {
+          cout << tc.name << " in place evaluation differs  FAILED\n";
+          ++nerr;
+        }
+
+        if ( levels[l] != simd::Scalar ) {
+          if ( ref2[t].empty() ) {
+            ref2[t] = c;
+          } else if ( memcmp( &ref2[t].front(), &c.front(), m*sizeof(double) ) != 0 ) {
+            cout << tc.name << " results differ between vector levels  FAILED\n";
+            ++nerr;
+          }
+        }
+
+        double maxulp = 0, amax = 0, bmax = 0;
+        for ( int i = 0; i < m; ++i ) {
+          double d = ulp_distance( c[i], tc.fun(a[i],b[i]) );
+          if ( d > maxulp ) { maxulp = d; amax = a[i]; bmax = b[i]; }
+        }
+        bool ok = maxulp <= tc.bound;
+        if ( !ok ) ++nerr;
+        cout << std::setw(6) << tc.name << " max " << maxulp << " ULP (bound " << tc.bound << ")";
+        if ( maxulp > 0 )
+          cout << " at " << std::setprecision(17) << amax << ", " << bmax << std::setprecision(6);
+        cout << ( ok ? "" : "  FAILED" ) << "\n";
+      }
+    }
+  }
+
+  // special arguments computed in the scratch memory of a Program,
+  // so that the kernels are called in place
+  {
+    char const * exprs[] = {
+      "exp(x*1000)", "exp(-x*1000)", "sin(x*1e7)", "cos(x*1e7)", "tan(x*1e7)",
+      "log(x-1)", "log(-x)", "log10(x-1)", "log10(x*1e-320)"
+    };
+    int const      nr = 8;
+    vector<double> in(nr,1.0), res(nr);
+    double const * inputs[] = { &in.front() };
+    Program<double>::Workspace ws;
+    for ( int l = 0; l < 3; ++l ) {
+      simd::set_level( levels[l] );
+      if ( simd::level() != levels[l] ) continue;
+      for ( size_t e = 0; e < sizeof(exprs)/sizeof(exprs[0]); ++e ) {
+        Calculator<double> ee;
+        Program<double>    prog;
+        ee.set( "x", 1 );
+        ee.parse( exprs[e] );
+        double expected = ee.get_value();
+        prog.compile( ee, exprs[e], vector<std::string>(1,"x") );
+        prog.eval( nr, inputs, &res.front(), 0, ws );
+        for ( int i = 0; i < nr; ++i ) {
+          if ( ulp_distance( res[i], expected ) > 4 ) {
+            cout << "level " << levels[l] << " " << exprs[e] << " = " << res[i]
+                 << " expected " << expected << "  FAILED\n";
+            ++nerr;
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  // constant exponents are computed by multiplications or sqrt,
+  // they must agree with pow also on the special values
+  {
+    char const * exprs[] = {
+      "x^0", "x^1", "x^2", "x^3", "x^5", "x^8", "x^-1", "x^-2", "x^-3", "x^-8",
+      "x^0.5", "x^2.5", "x^9", "(x+1)^2*3", "x^(1+1)", "x^-0.5"
+    };
+    double const inf = std::numeric_limits<double>::infinity();
+    double const sp[] = {
+      0.0, -0.0, 1.0, -1.0, inf, -inf, std::numeric_limits<double>::quiet_NaN(),
+      1e39, -1e39, 1e103, -1e103, 1e160, -1e160, 1e-39, 1e-103, -1e-160
+    };
+    int const    nsp  = sizeof(sp)/sizeof(sp[0]);
+    int const    nr   = 300;
+    vector<double> in(nr), res(nr);
+    unsigned long long seed = 7;
+    for ( int i = 0; i < nr; ++i )
+      in[i] = i < nsp ? sp[i] : (i%2 ? -1 : 1)*std::exp( 14*( sample(seed) - 0.5 ) );
+    double const * inputs[] = { &in.front() };
+    Program<double>::Workspace ws;
+    for ( int l = 0; l < 3; ++l ) {
+      simd::set_level( levels[l] );
+      if ( simd::level() != levels[l] ) continue;
+      for ( size_t e = 0; e < sizeof(exprs)/sizeof(exprs[0]); ++e ) {
+        Calculator<double> ee;
+        Program<double>    prog;
+        ee.set( "x", 0 );
+        prog.compile( ee, exprs[e], vector<std::string>(1,"x") );
+        prog.eval( nr, inputs, &res.front(), 0, ws );
+        for ( int i = 0; i < nr; ++i ) {
+          ee.set( "x", in[i] );
+          ee.parse( exprs[e] );
+          double expected = ee.get_value();
+          bool   same     = std::isnan(expected) ? std::isnan(res[i])
+                                                 : std::signbit(expected) == std::signbit(res[i]) &&
+                                                   ulp_distance( res[i], expected ) <= 4;
+          if ( !same ) {
+            cout << "level " << levels[l] << " " << exprs[e] << " at x = " << in[i]
+                 << ": " << res[i] << " expected " << expected << "  FAILED\n";
+            ++nerr;
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  // throughput with respect to libm
+  {
+    simd::set_level( simd::AVX2 );
+    for ( int i = 0; i < n; ++i ) x[i] = 20*( double(i)/n - 0.5 );
+    int const nrep = 50;
+    clock_t t0 = clock();
+    for ( int r = 0; r < nrep; ++r ) simd::loop1<simd::s_sin>( n, &x.front(), &y.front() );
+    clock_t t1 = clock();
+    for ( int r = 0; r < nrep; ++r ) simd::vsin( n, &x.front(), &y.front() );
+    clock_t t2 = clock();
+    for ( int r = 0; r < nrep; ++r ) simd::loop1<simd::s_exp>( n, &x.front(), &y.front() );
+    clock_t t3 = clock();
+    for ( int r = 0; r < nrep; ++r ) simd::vexp( n, &x.front(), &y.front() );
+    clock_t t4 = clock();
+    double const scale = 1e9/CLOCKS_PER_SEC/(double(n)*nrep);
+    cout << "\nlevel " << simd::level() << " ns/value: "
+         << "sin libm " << (t1-t0)*scale << ", vector " << (t2-t1)*scale << "; "
+         << "exp libm " << (t3-t2)*scale << ", vector " << (t4-t3)*scale << "\n";
+  }
+
+  cout << ( nerr == 0 ? "\nsimd test passed" : "\nsimd test FAILED" ) << endl;
+  return nerr == 0 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+
+# include "calc_store.hh"
+
+# include <thread>
+# include <atomic>
+# include <chrono>
+
+using namespace calc_load;
+
+using std::string;
+using std::vector;
+using std::cout;
+using std::endl;
+
+typedef Calculator<double>     CALC;
+typedef Variable_store<double> STORE;
+
+static int n_errors = 0;
+
+static
+void
+check( bool ok, char const * what ) {
+  if ( !ok ) { cout << "FAILED: " << what << endl; ++n_errors; }
+}
+
+// readers check that a+b+c == 0 and that the versions never go back
+static
+void
+reader( STORE & store, std::atomic<bool> & stop,
+        long & n_eval, long & n_torn, long & n_back ) {
+  CALC          ee;
+  STORE::Reader rd(store);
+  unsigned long last = 0, last_current = 0;
+  n_eval = n_torn = n_back = 0;
+  while ( !stop.load() ) {
+    rd.parse( ee, "a+b+c" );
+    if ( ee.get_value() != 0 ) ++n_torn;
+    STORE::Version const & v = rd.acquire();
+    if ( v.number < last || v.vars.at("v") != double(v.number) ) ++n_back;
+    last = v.number;
+    rd.release();
+    // the number of the current version is read without pinning it
+    unsigned long cur = store.version();
+    if ( cur < last_current ) ++n_back;
+    last_current = cur;
+    ++n_eval;
+  }
+}
+
+int
+main() {
+
+  // pinned versions stay valid and are reclaimed on release
+  {
+    STORE         store;
+    STORE::Reader rd(store);
+    CALC          ee;
+    store.set( "x", 1 );
+    STORE::Version const & v = rd.acquire();
+    for ( int i = 2; i <= 100; ++i ) store.set( "x", i );
+    check( v.vars.at("x") == 1, "pinned value" );
+    check( store.retired_count() == 1, "only the pinned version retained" );
+    rd.release();
+    rd.parse( ee, "y=2*x" );
+    check( ee.get_value() == 200, "parse against current version" );
+    check( !ee.exist("x"), "store detached after parse" );
+    store.drop( "x" );
+    check( store.retired_count() == 0, "retired versions reclaimed" );
+    check( store.version() == 101, "version number" );
+  }
+
+  // stress: one writer, many readers
+  STORE::map_real init;
+  init["a"] = init["b"] = init["c"] = init["v"] = 0;
+  STORE store(init);
+
+  unsigned const    n_readers = 4;
+  std::atomic<bool> stop(false);
+  vector<long>      n_eval(n_readers), n_torn(n_readers), n_back(n_readers);
+  vector<std::thread> threads;
+  for ( unsigned i = 0; i < n_readers; ++i )
+    threads.push_back( std::thread( reader, std::ref(store), std::ref(stop),
+                                    std::ref(n_eval[i]), std::ref(n_torn[i]),
+                                    std::ref(n_back[i]) ) );
+
+  auto  t0 = std::chrono::steady_clock::now();
+  long  n_updates = 0;
+  while ( std::chrono::steady_clock::now()-t0 < std::chrono::milliseconds(500) ||
+          n_updates < 1000 ) {
+    double r = double(n_updates % 1000 + 1);
+    store.update( [&]( STORE::map_real & vars ) {
+      vars["a"] = r;
+      vars["b"] = -3*r;
+      vars["c"] = 2*r;
+      vars["v"] = double(vars["v"]+1);
+    } );
+    ++n_updates;
+    if ( n_updates % 64 == 0 ) std::this_thread::yield();
+  }
+  stop.store(true);
+  for ( unsigned i = 0; i < n_readers; ++i ) threads[i].join();
+
+  long tot_eval = 0, tot_torn = 0, tot_back = 0;
+  for ( unsigned i = 0; i < n_readers; ++i ) {
+    tot_eval += n_eval[i]; tot_torn += n_torn[i]; tot_back += n_back[i];
+  }
+  cout << n_updates << " updates, " << tot_eval << " evaluations by "
+       << n_readers << " readers\n";
+  check( tot_torn == 0, "no torn update seen" );
+  check( tot_back == 0, "versions are monotone" );
+  check( store.version() == (unsigned long)n_updates, "all updates published" );
+  store.set( "a", 0 );
+  check( store.retired_count() == 0, "all versions reclaimed" );
+
+  if ( n_errors == 0 ) cout << "store_test: all tests passed" << endl;
+  return n_errors == 0 ? 0 : 1;
+}
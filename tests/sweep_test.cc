@@ -0,0 +1,171 @@
+
+# include "calc_sweep.hh"
+# include "calc_memo.hh"
+
+# include <chrono>
+# include <cmath>
+
+using namespace calc_load;
+
+using std::string;
+using std::vector;
+using std::cout;
+using std::endl;
+
+typedef Calculator<double> CALC;
+typedef Sweep<double>      SWEEP;
+
+static
+double
+damping( double const x )
+{ return std::exp(-x*x); }
+
+static
+double
+seconds_since( std::chrono::steady_clock::time_point const & t0 ) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+}
+
+int
+main() {
+
+  CALC ee;
+  ee.set_unary_fun("damping",damping);
+  ee.set("c", 0.5);
+
+  string const expr = "r = sqrt(x^2+y^2); damping(r)*cos(c*x)*z";
+
+  SWEEP sw(ee);
+  sw.add_range( "x", -2, 2, 101 );
+  sw.add_range( "y", -1, 1, 51 );
+  sw.add_list( "z", vector<double>{ 1, -1, 2 } );
+  sw.set_chunk(64);
+  sw.set_threads(4);
+
+  size_t const   n = sw.size();
+  vector<double> out(n), par(3);
+  SWEEP::Result  res;
+
+  auto t0 = std::chrono::steady_clock::now();
+  bool ok = sw.run( expr, res, &out.front() );
+  double tpar = seconds_since(t0);
+
+  // compare with a sequential evaluation, the vectorized builtins
+  // may differ in the last bits
+  int    nerr = 0;
+  double smin = 1e300, ssum = 0;
+  for ( size_t i = 0; i < n; ++i ) {
+    sw.point( i, &par.front() );
+    ee.set("x",par[0]); ee.set("y",par[1]); ee.set("z",par[2]);
+    ee.parse(expr);
+    double v = ee.get_value();
+    if ( std::abs(v-out[i]) > 1e-14 ) ++nerr;
+    if ( v < smin ) smin = v;
+    ssum += v;
+  }
+  if ( !ok || res.n_points != n || res.n_errors != 0 ) ++nerr;
+  if ( std::abs(res.min-smin) > 1e-14 || out[res.argmin] != res.min ) ++nerr;
+  if ( std::abs(res.sum-ssum) > 1e-9*n ) ++nerr;
+
+  // streaming with a single thread, errors on the points with x = 0
+  SWEEP sw1(ee);
+  sw1.add_range( "x", -2, 2, 101 );
+  sw1.add_range( "y", -1, 1, 51 );
+  sw1.add_list( "z", vector<double>{ 1, -1, 2 } );
+  sw1.set_threads(1);
+  size_t streamed = 0;
+  t0 = std::chrono::steady_clock::now();
+  sw1.run( expr, res, nullptr,
+           [&streamed]( size_t, size_t count, double const * ) { streamed += count; } );
+  double tseq = seconds_since(t0);
+  if ( streamed != n ) ++nerr;
+  sw1.run( "1/x", res );
+  if ( res.n_errors != 51*3 || res.n_points != n-51*3 ) ++nerr;
+  // not compilable (index of w@k computed), parsed at each point
+  sw1.run( "k=2; w@k=x; w2-x+1", res );
+  if ( res.n_points != n || res.sum != n ) ++nerr;
+
+  // NaN values without errors are left out of the reductions, the
+  // results do not depend on the partition among the threads
+  {
+    SWEEP swn(ee);
+    swn.add_range( "x", -1, 1, 4001 );
+    swn.set_chunk(64);
+    SWEEP::Result r1, r4;
+    swn.set_threads(1);
+    swn.run( "sqrt(x)", r1 );
+    swn.set_threads(4);
+    swn.run( "sqrt(x)", r4 );
+    if ( r1.n_nans != 2000 || r1.n_points != 2001 || r1.n_errors != 0 ) ++nerr;
+    if ( r1.min != 0 || r1.argmin != 2000 || r1.max != 1 || r1.argmax != 4000 ) ++nerr;
+    if ( r1.sum != r1.sum ) ++nerr;
+    if ( r4.n_nans != r1.n_nans || r4.n_points != r1.n_points ||
+         r4.min != r1.min || r4.argmin != r1.argmin ||
+         r4.max != r1.max || r4.argmax != r1.argmax ||
+         std::abs(r4.sum-r1.sum) > 1e-12*r1.sum ) ++nerr;
+  }
+
+  // a parameter assigned by the expression is restored at each point,
+  // compiled or parsed
+  {
+    SWEEP swa(ee);
+    swa.add_list( "x", vector<double>{ 1, 2 } );
+    swa.add_list( "y", vector<double>{ 0, 0, 0 } );
+    swa.set_threads(1);
+    double const expected[] = { 2, 2, 2, 3, 3, 3 };
+    char const * exprs[] = { "x = x+1; x+y", "k=1; w@k=0; x = x+1; x+y" };
+    for ( int e = 0; e < 2; ++e ) {
+      vector<double> o(6);
+      swa.run( exprs[e], res, &o.front() );
+      for ( int i = 0; i < 6; ++i ) if ( o[i] != expected[i] ) { ++nerr; break; }
+    }
+  }
+
+  // a memoized function shared by the workers, with a small cache so
+  // that the threads overwrite each other's entries
+  {
+    CALC eem;
+    Memoized1<double> m_damping( damping, 16 );
+    eem.set_unary_fun( "damping", &m_damping );
+    SWEEP swm(eem);
+    swm.add_range( "x", -2, 2, 401 );
+    swm.add_range( "y", -1, 1, 101 );
+    swm.set_threads(4);
+    swm.set_chunk(64);
+    vector<double> o(swm.size());
+    swm.run( "damping(x*y)+damping(x)", res, &o.front() );
+    for ( size_t i = 0; i < o.size(); ++i ) {
+      double p[2];
+      swm.point( i, p );
+      if ( o[i] != damping(p[0]*p[1])+damping(p[0]) ) { ++nerr; break; }
+    }
+
+    // direct concurrent calls
+    Memoized2<double> m_hypot( [](double a, double b) { return std::sqrt(a*a+b*b); }, 8 );
+    std::atomic<int> bad(0);
+    vector<std::thread> th;
+    for ( int t = 0; t < 4; ++t )
+      th.push_back( std::thread( [&m_hypot,&bad,t]() {
+        for ( int i = 0; i < 200000; ++i ) {
+          double a = (i*7+t)%13, b = (i*3)%11;
+          if ( m_hypot.eval(a,b) != std::sqrt(a*a+b*b) ) ++bad;
+        }
+      } ) );
+    for ( size_t t = 0; t < th.size(); ++t ) th[t].join();
+    if ( bad != 0 || m_hypot.hits()+m_hypot.misses() != 800000 ) ++nerr;
+  }
+
+  // zipped lists
+  SWEEP swz(ee);
+  swz.set_mode( SWEEP::Zip );
+  swz.add_list( "a", vector<double>{ 1, 2, 3, 4 } );
+  swz.add_list( "b", vector<double>{ 4, 3, 2, 1 } );
+  swz.run( "a*b", res );
+  if ( swz.size() != 4 || res.max != 6 || res.argmax != 1 || res.sum != 20 ) ++nerr;
+
+  cout << n << " points, "
+       << n/tseq << " points/s (1 thread), "
+       << n/tpar << " points/s (4 threads)\n";
+  cout << ( nerr == 0 ? "sweep test passed" : "sweep test FAILED" ) << endl;
+  return nerr == 0 ? 0 : 1;
+}
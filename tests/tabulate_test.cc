@@ -0,0 +1,129 @@
+
+# include "calc_tabulate.hh"
+# include "calc_batch.hh"
+
+# include <ctime>
+# include <vector>
+
+using namespace calc_load;
+
+using std::string;
+using std::vector;
+using std::cout;
+using std::endl;
+
+typedef Calculator<double> CALC;
+
+// an expensive function: integral of exp(-y*t^2) in [0,x] by Simpson rule
+static
+double
+gauss_int2( double const x, double const y ) {
+  int const n = 200;
+  double    h = x/n, s = 1 + std::exp(-y*x*x);
+  for ( int i = 1; i < n; ++i ) {
+    double t = i*h;
+    s += (i % 2 ? 4 : 2) * std::exp(-y*t*t);
+  }
+  return s*h/3;
+}
+
+static
+double
+gauss_int( double const x )
+{ return gauss_int2(x,1); }
+
+static
+double
+elapsed( clock_t t0 )
+{ return double(clock()-t0)/CLOCKS_PER_SEC; }
+
+int
+main() {
+
+  int nerr = 0;
+
+  Tabulated1<double> tab;
+  bool ok = tab.build( gauss_int, 0, 3, 1e-10 );
+  cout << "unary table: " << tab.cells() << " cells, "
+       << tab.memory() << " bytes, error estimate " << tab.error_estimate() << "\n";
+  if ( !ok ) ++nerr;
+
+  // check the error on random points and the fallback outside [0,3]
+  double maxerr = 0;
+  for ( int i = 0; i <= 100000; ++i ) {
+    double x = 3.0*((i*7919) % 100001)/100000.0;
+    double e = std::abs( tab.eval(x) - gauss_int(x) );
+    if ( e > maxerr ) maxerr = e;
+  }
+  cout << "max error " << maxerr << "\n";
+  if ( maxerr > 1e-9 ) ++nerr;
+  if ( tab.eval(5) != gauss_int(5) || tab.eval(-1) != gauss_int(-1) ) ++nerr;
+
+  // speed inside parse()
+  CALC ee_exact, ee_tab;
+  ee_exact.set_unary_fun( "G", gauss_int );
+  ee_tab.set_unary_fun( "G", &tab );
+  int const np = 20000;
+  double    sum1 = 0, sum2 = 0;
+  clock_t   t0 = clock();
+  for ( int i = 0; i < np; ++i ) {
+    ee_exact.set( "x", 3.0*i/np );
+    ee_exact.parse( "G(x)*2+1" );
+    sum1 += ee_exact.get_value();
+  }
+  double t_exact = elapsed(t0);
+  t0 = clock();
+  for ( int i = 0; i < np; ++i ) {
+    ee_tab.set( "x", 3.0*i/np );
+    ee_tab.parse( "G(x)*2+1" );
+    sum2 += ee_tab.get_value();
+  }
+  double t_tab = elapsed(t0);
+  cout << "parse(): exact " << 1e9*t_exact/np << " ns, tabulated "
+       << 1e9*t_tab/np << " ns per evaluation\n";
+  if ( std::abs(sum1-sum2) > 1e-9*np ) ++nerr;
+
+  // speed in bulk evaluation
+  int const      nb = 200000;
+  vector<double> x(nb), r1(nb), r2(nb);
+  for ( int i = 0; i < nb; ++i ) x[i] = 3.0*i/nb;
+  double const * cols[] = { &x.front() };
+  vector<string> inputs(1,"x");
+  Program<double> p1, p2;
+  Program<double>::Workspace ws;
+  p1.compile( ee_exact, "G(x)*2+1", inputs );
+  p2.compile( ee_tab, "G(x)*2+1", inputs );
+  t0 = clock();
+  p1.eval( nb, cols, &r1.front(), 0, ws );
+  t_exact = elapsed(t0);
+  t0 = clock();
+  p2.eval( nb, cols, &r2.front(), 0, ws );
+  t_tab = elapsed(t0);
+  cout << "bulk:    exact " << 1e9*t_exact/nb << " ns, tabulated "
+       << 1e9*t_tab/nb << " ns per evaluation\n";
+  for ( int i = 0; i < nb; ++i ) if ( std::abs(r1[i]-r2[i]) > 2e-9 ) { ++nerr; break; }
+
+  // binary function
+  Tabulated2<double> tab2;
+  ok = tab2.build( gauss_int2, 0, 2, 0.5, 2, 1e-8 );
+  cout << "binary table: " << tab2.nodes() << " nodes, error estimate "
+       << tab2.error_estimate() << "\n";
+  if ( !ok ) ++nerr;
+  maxerr = 0;
+  for ( int i = 0; i <= 300; ++i ) {
+    for ( int j = 0; j <= 300; ++j ) {
+      double xx = 2.0*((i*97) % 301)/300, yy = 0.5+1.5*((j*89) % 301)/300;
+      double e = std::abs( tab2.eval(xx,yy) - gauss_int2(xx,yy) );
+      if ( e > maxerr ) maxerr = e;
+    }
+  }
+  cout << "max error " << maxerr << "\n";
+  if ( maxerr > 1e-7 ) ++nerr;
+  CALC ee2;
+  ee2.set_binary_fun( "G2", &tab2 );
+  ee2.parse( "G2(1,1) - G2(3,1)" );
+  if ( std::abs( ee2.get_value() - (gauss_int2(1,1)-gauss_int2(3,1)) ) > 1e-7 ) ++nerr;
+
+  cout << ( nerr == 0 ? "tabulate test passed" : "tabulate test FAILED" ) << endl;
+  return nerr == 0 ? 0 : 1;
+}
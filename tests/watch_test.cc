@@ -0,0 +1,249 @@
+
+# include "calc_watch.hh"
+
+# include <chrono>
+# include <fstream>
+# include <sstream>
+# include <cstdio>
+# include <cstdlib>
+
+using namespace calc_load;
+
+using std::string;
+using std::vector;
+using std::cout;
+using std::endl;
+
+typedef Calculator<double>     CALC;
+typedef Variable_store<double> STORE;
+typedef Deck<double>           DECK;
+typedef Deck_watcher<double>   WATCHER;
+
+static int n_errors = 0;
+
+static
+void
+check( bool ok, string const & what ) {
+  if ( !ok ) { cout << "FAILED: " << what << endl; ++n_errors; }
+}
+
+static
+string
+join( vector<string> const & v ) {
+  string s;
+  for ( size_t i = 0; i < v.size(); ++i ) s += (i > 0 ? " " : "") + v[i];
+  return s;
+}
+
+// the deck variables must be the ones computed by parse
+static
+bool
+same_as_parse( CALC const & base, STORE & store, DECK const & deck, string const & text ) {
+  CALC ee;
+  ee.symbols_merge(base);
+  std::istringstream in(text);
+  string line;
+  while ( std::getline(in,line) ) ee.parse(line);
+  CALC::map_real const & ref = ee.variables_map();
+  STORE::Reader rd(store);
+  CALC::map_real const & pub = rd.acquire().vars;
+  bool ok = ref.size() == deck.variables().size() + base.variables_map().size();
+  for ( CALC::map_real::const_iterator i = ref.begin(); ok && i != ref.end(); ++i ) {
+    if ( base.variables_map().count(i->first) ) continue;
+    CALC::map_real::const_iterator j = pub.find(i->first);
+    ok = j != pub.end() && j->second == i->second;
+  }
+  return ok;
+}
+
+static
+string
+replace_line( string const & text, size_t n, string const & line ) {
+  std::istringstream in(text);
+  string l, res;
+  for ( size_t i = 0; std::getline(in,l); ++i )
+    res += (i == n ? line : l) + "\n";
+  return res;
+}
+
+static
+void
+write_file( string const & name, string const & text ) {
+  std::ofstream f(name.c_str());
+  f << text;
+}
+
+int
+main() {
+
+  CALC base;
+  base.set("g", 9.81);
+
+  // incremental updates
+  {
+    STORE          store;
+    DECK           deck(base, store);
+    vector<string> changed;
+    string text =
+      "a = 1            # first\n"
+      "b = a*2\n"
+      "i=0\n"
+      "i=i+1; K@i = b+g\n"
+      "i=i+1\n"
+      "K@i = 10\n"
+      "c = 5\n"
+      "d = c*c\n";
+    deck.update( text, changed );
+    check( deck.size() == 9 && deck.evaluated() == 9, "initial evaluation" );
+    check( join(changed) == "K1 K2 a b c d i", "initial variables: " + join(changed) );
+    check( same_as_parse(base, store, deck, text), "initial values" );
+
+    text = replace_line( text, 0, "a = 2 # first" );
+    deck.update( text, changed );
+    check( deck.evaluated() == 3, "a: evaluated a, b, K@i" );
+    check( join(changed) == "K1 a b", "a: changed " + join(changed) );
+    check( same_as_parse(base, store, deck, text), "a: values" );
+
+    text = replace_line( text, 6, "c = 6" );
+    deck.update( text, changed );
+    check( deck.evaluated() == 2 && join(changed) == "c d", "c: changed " + join(changed) );
+
+    // the indexed names move
+    text = replace_line( text, 2, "i=1" );
+    deck.update( text, changed );
+    check( join(changed) == "K1 K2 K3 i", "i: changed " + join(changed) );
+    check( same_as_parse(base, store, deck, text), "i: values" );
+
+    // a removed assignment is removed from the store
+    text = replace_line( text, 7, "" );
+    deck.update( text, changed );
+    check( join(changed) == "d" && deck.evaluated() == 0, "drop d" );
+    STORE::Reader rd(store);
+    check( rd.acquire().vars.count("d") == 0, "d removed from the store" );
+    rd.release();
+
+    // no change
+    deck.update( text + "\n# comment\n", changed );
+    check( changed.empty() && deck.evaluated() == 0, "comments only" );
+
+    // an error stops only the statement
+    text = replace_line( text, 1, "b = a*zz" );
+    size_t n_err = deck.update( text, changed );
+    check( n_err == 2, "errors reported" ); // b and K@i reading b
+    check( join(changed) == "K2 b", "error: changed " + join(changed) );
+    check( same_as_parse(base, store, deck, text), "error: values" );
+  }
+
+  // assignments nested in an expression
+  {
+    STORE          store;
+    DECK           deck(base, store);
+    vector<string> changed;
+    string text = "x = (y = 2) + 1\nz = y*10\nw = (u = z) + (v = u+1)\n";
+    check( deck.update( text, changed ) == 0, "nested: no error" );
+    check( join(changed) == "u v w x y z", "nested: variables " + join(changed) );
+    check( same_as_parse(base, store, deck, text), "nested: values" );
+    text = replace_line( text, 0, "x = (y = 3) + 1" );
+    deck.update( text, changed );
+    check( join(changed) == "u v w x y z" && deck.evaluated() == 3, "nested: changed " + join(changed) );
+    check( same_as_parse(base, store, deck, text), "nested: values after the edit" );
+    text = replace_line( text, 0, "x = 4" );
+    deck.update( text, changed );
+    check( join(changed) == "u v w y z", "nested: y removed " + join(changed) );
+    check( same_as_parse(base, store, deck, text), "nested: values after y removed" );
+  }
+
+  // random edits compared with parse
+  {
+    STORE          store;
+    DECK           deck(base, store);
+    vector<string> changed, lines;
+    std::srand(1234);
+    for ( int i = 0; i < 200; ++i ) {
+      std::ostringstream s;
+      s << "v" << i % 37 << " = ";
+      if ( i < 5 ) s << i+1;
+      else s << "v" << std::rand() % 5 << "+" << (std::rand() % 7) << "*v" << std::rand() % 5;
+      lines.push_back(s.str());
+    }
+    for ( int iter = 0; iter < 200; ++iter ) {
+      size_t n  = std::rand() % lines.size();
+      int    op = std::rand() % 3;
+      std::ostringstream s;
+      s << "v" << std::rand() % 37 << " = v" << std::rand() % 37 << "/2+" << iter % 5;
+      if ( iter % 4 == 0 ) s << "+(v" << std::rand() % 37 << " = 1)"; // nested assignment
+      if      ( op == 0 ) lines[n] = s.str();
+      else if ( op == 1 ) lines.insert( lines.begin()+n, s.str() );
+      else                lines.erase( lines.begin()+n );
+      string text;
+      for ( size_t k = 0; k < lines.size(); ++k ) text += lines[k] + "\n";
+      deck.update( text, changed );
+      if ( !same_as_parse(base, store, deck, text) ) {
+        check( false, "random edits" );
+        break;
+      }
+    }
+  }
+
+  // reload time of a large deck depends on the edit
+  {
+    STORE          store;
+    DECK           deck(base, store);
+    vector<string> changed;
+    std::ostringstream s;
+    s << "x0 = 1\n";
+    for ( int i = 1; i < 20000; ++i )
+      s << "x" << i << " = x" << i-1 << "*1.0001+sin(" << i << ")\n";
+    string text = s.str();
+    auto t0 = std::chrono::steady_clock::now();
+    deck.update( text, changed );
+    auto t1 = std::chrono::steady_clock::now();
+    text = replace_line( text, 19990, "x19990 = 0" );
+    deck.update( text, changed );
+    auto t2 = std::chrono::steady_clock::now();
+    cout << "deck of 20000 lines: load "
+         << std::chrono::duration<double,std::milli>(t1-t0).count() << " ms, reload "
+         << std::chrono::duration<double,std::milli>(t2-t1).count() << " ms ("
+         << deck.evaluated() << " statements evaluated)\n";
+    check( deck.evaluated() == 10 && changed.size() == 10, "large deck" );
+  }
+
+  // watch a file
+  {
+    char dir[] = "/tmp/watch_testXXXXXX";
+    check( mkdtemp(dir) != nullptr, "temporary directory" );
+    string file = string(dir) + "/deck.txt";
+    write_file( file, "p = 1\nq = p+1\n" );
+
+    STORE          store;
+    WATCHER        w(base, store);
+    vector<string> seen;
+    w.set_callback( [&]( string const &, vector<string> const & changed ) { seen = changed; } );
+    check( w.watch(file), "watch" );
+    check( join(seen) == "p q", "watch: load" );
+
+    // in place
+    std::this_thread::sleep_for( std::chrono::milliseconds(1100) ); // new mtime when polling
+    write_file( file, "p = 2\nq = p+1\n" );
+    for ( int k = 0; k < 20 && w.poll(100) == 0; ++k ) {}
+    check( join(seen) == "p q", "watch: write " + join(seen) );
+
+    // replaced by rename, as editors do
+    std::this_thread::sleep_for( std::chrono::milliseconds(1100) );
+    write_file( file + ".new", "p = 2\nq = p+2\n" );
+    std::rename( (file + ".new").c_str(), file.c_str() );
+    seen.clear();
+    for ( int k = 0; k < 20 && w.poll(100) == 0; ++k ) {}
+    check( join(seen) == "q", "watch: rename " + join(seen) );
+    STORE::Reader rd(store);
+    check( rd.acquire().vars.at("q") == 4, "watch: value" );
+    rd.release();
+    cout << "watching with " << (w.notified() ? "inotify" : "polling") << "\n";
+
+    std::remove( file.c_str() );
+    std::remove( dir );
+  }
+
+  if ( n_errors == 0 ) cout << "watch_test: all tests passed" << endl;
+  return n_errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,358 @@
+/*
+ * calc_batch: evaluate definitions `name = expr` over columns of data.
+ *
+ *   calc_batch [options] definition...
+ *
+ * The input columns are read from a CSV file with a header line (the
+ * names of the columns) or from binary files, one per column, of
+ * little endian doubles.  The output columns, the variables assigned
+ * by the definitions, are written as CSV or as binary files.  Files
+ * are memory mapped, the standard input is streamed.  The data are
+ * processed in chunks by many threads.
+ */
+
+# include "calc_columns.hh"
+
+# include <thread>
+# include <chrono>
+# include <cstdio>
+# include <cstring>
+# include <cstdint>
+
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+
+using namespace calc_load;
+
+using std::string;
+using std::vector;
+using std::cerr;
+using std::endl;
+
+typedef Calculator<double> CALC;
+typedef Columns<double>    COLUMNS;
+
+static
+void
+usage() {
+  cerr <<
+    "usage: calc_batch [options] definition...\n"
+    "  definition    name = expr, many can be separated by ;\n"
+    "  -i FILE       CSV input with a header line (default: standard input)\n"
+    "  -c NAME=FILE  binary input column (little endian doubles), replaces the CSV input\n"
+    "  -o FILE       CSV output (default: standard output)\n"
+    "  -b PREFIX     binary output, column NAME is written to PREFIXNAME.bin (little endian)\n"
+    "  -s N1,N2,...  output columns (default: all the assigned variables)\n"
+    "  -k            copy the input columns to the CSV output\n"
+    "  -f FILE       parse FILE (constants, parameters) before the definitions\n"
+    "  -d CHAR       CSV delimiter (default: ,)\n"
+    "  -p DIGITS     significant digits of the CSV output\n"
+    "  -t THREADS    number of threads (default: hardware threads)\n"
+    "  -q            do not report the throughput\n";
+}
+
+static
+void
+split( string const & s, char sep, vector<string> & v ) {
+  v.clear();
+  size_t b = 0;
+  for (;;) {
+    size_t e = s.find(sep,b);
+    v.push_back( s.substr(b, e == string::npos ? string::npos : e-b) );
+    if ( e == string::npos ) break;
+    b = e+1;
+  }
+}
+
+// a read only file, memory mapped when possible, else read
+class Input {
+  int          fd;
+  char const * data;
+  size_t       len;
+  bool         mapped;
+  bool         empty;
+  string       text;
+public:
+  Input() : fd(-1), data(0), len(0), mapped(false), empty(false) {}
+  ~Input() {
+    if ( mapped ) munmap( (void*)data, len );
+    if ( fd > 2 ) close(fd);
+  }
+  bool
+  open( string const & name ) {
+    fd = name == "-" ? 0 : ::open( name.c_str(), O_RDONLY );
+    if ( fd < 0 ) return false;
+    struct stat st;
+    if ( fstat(fd,&st) != 0 || !S_ISREG(st.st_mode) ) return true;
+    empty = st.st_size == 0; // cannot be mapped
+    if ( !empty ) {
+      void * p = mmap( 0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+      if ( p != MAP_FAILED ) {
+        madvise( p, st.st_size, MADV_SEQUENTIAL );
+        data = (char const *)p; len = st.st_size; mapped = true;
+      }
+    }
+    return true;
+  }
+  bool is_mapped() const { return mapped; }
+  bool is_empty_file() const { return empty; }
+  char const * begin() const { return data; }
+  char const * end() const { return data+len; }
+  size_t size() const { return len; }
+  // drop the first `consumed` bytes read from a stream, then read up to n more
+  size_t
+  read_more( size_t consumed, size_t n ) {
+    text.erase( 0, consumed );
+    size_t old = text.size();
+    text.resize( old+n );
+    size_t got = 0;
+    while ( got < n ) {
+      ssize_t r = ::read( fd, &text[old+got], n-got );
+      if ( r <= 0 ) break;
+      got += size_t(r);
+    }
+    text.resize( old+got );
+    data = text.data();
+    len  = text.size();
+    return got;
+  }
+};
+
+static
+bool
+little_endian() {
+  uint16_t one = 1;
+  return *(unsigned char const *)&one == 1;
+}
+
+int
+main( int argc, char const * argv[] ) {
+
+  string         csv_in = "-", csv_out = "-", bin_prefix, deck;
+  vector<string> bin_names, bin_files, outputs;
+  string         defs;
+  char           delim   = ',';
+  int            digits  = -1;
+  bool           keep    = false;
+  bool           quiet   = false;
+  unsigned       threads = std::thread::hardware_concurrency();
+
+  for ( int i = 1; i < argc; ++i ) {
+    string a = argv[i];
+    bool   has_arg = i+1 < argc;
+    if      ( a == "-i" && has_arg ) csv_in  = argv[++i];
+    else if ( a == "-o" && has_arg ) csv_out = argv[++i];
+    else if ( a == "-b" && has_arg ) bin_prefix = argv[++i];
+    else if ( a == "-f" && has_arg ) deck = argv[++i];
+    else if ( a == "-s" && has_arg ) split( argv[++i], ',', outputs );
+    else if ( a == "-d" && has_arg ) delim   = argv[++i][0];
+    else if ( a == "-p" && has_arg ) digits  = atoi(argv[++i]);
+    else if ( a == "-t" && has_arg ) threads = unsigned(atoi(argv[++i]));
+    else if ( a == "-k" ) keep  = true;
+    else if ( a == "-q" ) quiet = true;
+    else if ( a == "-c" && has_arg ) {
+      string c = argv[++i];
+      size_t eq = c.find('=');
+      if ( eq == string::npos ) { usage(); return 2; }
+      bin_names.push_back( c.substr(0,eq) );
+      bin_files.push_back( c.substr(eq+1) );
+    } else if ( a[0] == '-' && a.size() > 1 ) {
+      usage();
+      return 2;
+    } else {
+      if ( !defs.empty() ) defs += ';';
+      defs += a;
+    }
+  }
+  if ( defs.empty() ) { usage(); return 2; }
+  if ( threads == 0 ) threads = 1;
+
+  CALC ee;
+  if ( !deck.empty() ) ee.parse_file( deck, true );
+
+  COLUMNS cols;
+  cols.set_delimiter( delim );
+  cols.set_keep_inputs( keep );
+  if ( digits > 0 ) cols.set_digits( digits );
+
+  // open the inputs and compile
+  Input           csv;
+  vector<Input>   bins( bin_files.size() );
+  vector<string>  names;
+  size_t          n_rows = 0;
+  char const *    body   = 0;
+  if ( bin_files.empty() ) {
+    if ( !csv.open(csv_in) ) {
+      cerr << "calc_batch: cannot open '" << csv_in << "'\n";
+      return 1;
+    }
+    if ( !csv.is_mapped() )
+      while ( csv.read_more(0,65536) > 0 &&
+              memchr( csv.begin(), '\n', csv.size() ) == 0 ) {}
+    body = cols.csv_header( csv.begin(), csv.end(), names );
+  } else {
+    names = bin_names;
+    for ( size_t j = 0; j < bin_files.size(); ++j ) {
+      if ( !bins[j].open(bin_files[j]) ) {
+        cerr << "calc_batch: cannot open '" << bin_files[j] << "'\n";
+        return 1;
+      }
+      // an empty file has zero rows
+      if ( !bins[j].is_mapped() && !bins[j].is_empty_file() ) {
+        cerr << "calc_batch: cannot map '" << bin_files[j] << "'\n";
+        return 1;
+      }
+      size_t n = bins[j].size()/sizeof(double);
+      if ( j > 0 && n != n_rows ) {
+        cerr << "calc_batch: the binary columns have different lengths\n";
+        return 1;
+      }
+      n_rows = n;
+    }
+  }
+  if ( !cols.compile( ee, defs, names, outputs ) ) {
+    if ( cols.missing().empty() ) ee.report_error(cerr);
+    else cerr << "calc_batch: '" << cols.missing() << "' is not assigned\n";
+    return 1;
+  }
+
+  // the outputs
+  FILE *          out = 0;
+  vector<FILE*>   bin_out;
+  vector<string> const & out_names = cols.outputs();
+  if ( bin_prefix.empty() ) {
+    out = csv_out == "-" ? stdout : fopen( csv_out.c_str(), "w" );
+    if ( out == 0 ) { cerr << "calc_batch: cannot write '" << csv_out << "'\n"; return 1; }
+    string h;
+    cols.csv_header(h);
+    fwrite( h.data(), 1, h.size(), out );
+  } else {
+    for ( size_t k = 0; k < out_names.size(); ++k ) {
+      string f = bin_prefix + out_names[k] + ".bin";
+      bin_out.push_back( fopen( f.c_str(), "wb" ) );
+      if ( bin_out.back() == 0 ) { cerr << "calc_batch: cannot write '" << f << "'\n"; return 1; }
+    }
+  }
+
+  // chunks are processed in rounds of one chunk per thread,
+  // the results are written in order
+  size_t const                csv_chunk = size_t(1) << 20; // bytes
+  size_t const                bin_chunk = size_t(1) << 16; // rows
+  vector<COLUMNS::Buffer>     buf( threads );
+  vector<string>              text( threads );
+  vector<size_t>              rows( threads ), errs( threads );
+  vector<char const *>        cb( threads ), ce( threads );
+  vector<size_t>              first( threads );
+  bool const                  swap_bytes = !little_endian();
+  size_t                      n_done = 0, n_err = 0, next_row = 0;
+  char const *                pos = body;
+  bool                        eof = false;
+
+  auto work = [&]( unsigned t ) {
+    text[t].clear();
+    rows[t] = errs[t] = 0;
+    COLUMNS::Buffer & b = buf[t];
+    if ( bin_files.empty() ) {
+      rows[t] = cols.csv_parse( cb[t], ce[t], b );
+    } else {
+      size_t n = std::min( bin_chunk, n_rows-first[t] );
+      b.in.resize( names.size() );
+      b.in_ptr.resize( names.size() );
+      for ( size_t j = 0; j < names.size(); ++j ) {
+        double const * col = (double const *)bins[j].begin() + first[t];
+        if ( swap_bytes ) {
+          b.in[j].resize(n);
+          for ( size_t i = 0; i < n; ++i ) {
+            uint64_t u;
+            memcpy( &u, col+i, 8 );
+            u = __builtin_bswap64(u);
+            memcpy( &b.in[j][i], &u, 8 );
+          }
+          col = b.in[j].data();
+        }
+        b.in_ptr[j] = col; // evaluated in place
+      }
+      rows[t] = n;
+    }
+    errs[t] = cols.eval( rows[t], b.in_ptr.empty() ? 0 : b.in_ptr.data(), b );
+    if ( out != 0 ) {
+      cols.csv_format( rows[t], b, text[t] );
+    } else if ( swap_bytes ) {
+      // the output files are little endian as the inputs
+      for ( size_t k = 0; k < bin_out.size(); ++k )
+        for ( size_t i = 0; i < rows[t]; ++i ) {
+          uint64_t u;
+          memcpy( &u, &b.out[k][i], 8 );
+          u = __builtin_bswap64(u);
+          memcpy( &b.out[k][i], &u, 8 );
+        }
+    }
+  };
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (;;) {
+    // assign one chunk per thread
+    unsigned n_jobs = 0;
+    for ( ; n_jobs < threads; ++n_jobs ) {
+      if ( bin_files.empty() ) {
+        if ( csv.is_mapped() ) {
+          if ( pos >= csv.end() ) break;
+          cb[n_jobs] = pos;
+          ce[n_jobs] = pos = COLUMNS::chunk_end( pos, csv.end(), csv_chunk );
+        } else {
+          // streamed: the chunks of a round share the buffer, the
+          // rest of the last line is kept for the next round
+          if ( n_jobs == 0 ) {
+            size_t want = threads*csv_chunk;
+            eof = csv.read_more( pos-csv.begin(), want ) < want;
+            pos = csv.begin();
+          }
+          if ( pos >= csv.end() ) break;
+          char const * e = COLUMNS::chunk_end( pos, csv.end(), csv_chunk );
+          if ( e == csv.end() && !eof ) {
+            while ( e > pos && e[-1] != '\n' ) --e;
+            if ( e == pos ) break;
+          }
+          cb[n_jobs] = pos;
+          ce[n_jobs] = pos = e;
+        }
+      } else {
+        if ( next_row >= n_rows ) break;
+        first[n_jobs] = next_row;
+        next_row += std::min( bin_chunk, n_rows-next_row );
+      }
+    }
+    if ( n_jobs == 0 ) {
+      if ( bin_files.empty() && !csv.is_mapped() && !eof ) continue;
+      break;
+    }
+
+    vector<std::thread> pool;
+    for ( unsigned t = 1; t < n_jobs; ++t ) pool.push_back( std::thread( work, t ) );
+    work(0);
+    for ( size_t t = 0; t < pool.size(); ++t ) pool[t].join();
+
+    for ( unsigned t = 0; t < n_jobs; ++t ) {
+      if ( out != 0 ) {
+        fwrite( text[t].data(), 1, text[t].size(), out );
+      } else {
+        for ( size_t k = 0; k < bin_out.size(); ++k )
+          fwrite( buf[t].out[k].data(), sizeof(double), rows[t], bin_out[k] );
+      }
+      n_done += rows[t];
+      n_err  += errs[t];
+    }
+  }
+  if ( out != 0 && out != stdout ) fclose( out );
+  if ( out == stdout ) fflush( stdout );
+  for ( size_t k = 0; k < bin_out.size(); ++k ) fclose( bin_out[k] );
+  double secs = std::chrono::duration<double>( std::chrono::steady_clock::now()-t0 ).count();
+
+  if ( !quiet )
+    cerr << "calc_batch: " << n_done << " rows in " << secs << " s, "
+         << (secs > 0 ? double(n_done)/secs : 0) << " rows/s, "
+         << threads << " threads, " << n_err << " rows with errors\n";
+  return 0;
+}